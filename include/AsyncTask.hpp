@@ -0,0 +1,141 @@
+/**
+ * @author Douglas De Rizzo Meneghetti (douglasrizzom@gmail.com)
+ * @brief  Handles to observe and cancel optimizations running in the background
+ * @date   2017-8-25
+ */
+
+#ifndef NUMERICAL_ANALYSIS_ASYNCTASK_HPP
+#define NUMERICAL_ANALYSIS_ASYNCTASK_HPP
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+
+using namespace std;
+
+//! Snapshot of the state of a running optimization
+//! \tparam A the scalar type of the estimates
+template<typename A>
+struct Progress {
+  //! number of samples, quadratures or iterations done so far
+  long int samples;
+  //! current estimate of the result
+  A estimate;
+  //! current error of the estimate
+  A error;
+};
+
+//! State shared between a running optimization and its handle, used to report
+//! progress and to request cancellation
+//! \tparam A the scalar type of the estimates
+template<typename A>
+class ProgressMonitor {
+ public:
+  typedef function<void(const Progress<A> &)> Callback;
+
+ private:
+  Callback callback;
+  atomic<bool> cancelled{false};
+  long int chunkSize;
+  long int lastReport = 0;
+
+ public:
+  //! \param callback function called at every chunk boundary, from the thread running the optimization
+  //! \param chunkSize number of samples or iterations between two cancellation checks and progress reports
+  ProgressMonitor(const Callback &callback, long int chunkSize)
+      : callback(callback), chunkSize(chunkSize < 1 ? 1 : chunkSize) {}
+
+  void cancel() { cancelled = true; }
+
+  bool isCancelled() const { return cancelled.load(memory_order_relaxed); }
+
+  long int getChunkSize() const { return chunkSize; }
+
+  //! Sends a progress report to the callback, if there is one
+  void report(long int samples, A estimate, A error) {
+    lastReport = samples;
+    if (callback)
+      callback({samples, estimate, error});
+  }
+
+  //! \return true if at least one chunk was done since the last report, so that
+  //! estimates which are costly to compute are only computed when they will be reported
+  bool due(long int samples) const {
+    return samples - lastReport >= chunkSize;
+  }
+
+  //! Sends a progress report only if at least one chunk was done since the last report
+  //! \return true if a chunk boundary was crossed, in which case cancellation should be checked
+  bool checkpoint(long int samples, A estimate, A error) {
+    if (not due(samples))
+      return false;
+    report(samples, estimate, error);
+    return true;
+  }
+};
+
+//! Handle to an optimization running in the shared thread pool
+//! \tparam R the type of the result of the optimization
+//! \tparam A the scalar type of the estimates and errors
+template<typename R, typename A>
+class AsyncTask {
+ public:
+  //! Everything the optimizer knows when the optimization ends
+  struct Outcome {
+    R result;
+    long int iterations;
+    A error;
+    string endReason;
+    double executionTime;
+  };
+
+ private:
+  shared_ptr<ProgressMonitor<A>> monitor;
+  shared_future<Outcome> outcome;
+
+ public:
+  AsyncTask(const shared_ptr<ProgressMonitor<A>> &monitor, const shared_future<Outcome> &outcome)
+      : monitor(monitor), outcome(outcome) {}
+
+  //! Asks the optimization to stop at the next chunk boundary. The result will
+  //! then be the best estimate computed until that point
+  void cancel() { monitor->cancel(); }
+
+  bool isCancelled() const { return monitor->isCancelled(); }
+
+  //! \return true if the optimization has ended
+  bool isReady() const {
+    return outcome.wait_for(chrono::seconds(0)) == future_status::ready;
+  }
+
+  //! Blocks until the optimization ends
+  void wait() const { outcome.wait(); }
+
+  //! Blocks until the optimization ends or the timeout expires
+  //! \param timeout maximum time to wait
+  //! \return true if the optimization has ended
+  template<typename Rep, typename Period>
+  bool waitFor(const chrono::duration<Rep, Period> &timeout) const {
+    return outcome.wait_for(timeout) == future_status::ready;
+  }
+
+  //! Blocks until the optimization ends, rethrowing any exception it threw
+  //! \return the result of the optimization, or the best partial result if it was cancelled
+  R get() const { return outcome.get().result; }
+
+  //! \return number of iterations until convergence, or of samples of the Monte Carlo methods
+  long int getIterations() const { return outcome.get().iterations; }
+
+  //! \return error of approximation
+  A getError() const { return outcome.get().error; }
+
+  //! \return reason for ending the process
+  const string &getEndReason() const { return outcome.get().endReason; }
+
+  double getExecutionTime() const { return outcome.get().executionTime; }
+};
+
+#endif //NUMERICAL_ANALYSIS_ASYNCTASK_HPP
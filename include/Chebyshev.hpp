@@ -0,0 +1,492 @@
+/**
+ * @author Douglas De Rizzo Meneghetti (douglasrizzom@gmail.com)
+ * @brief  Chebyshev interpolant of a smooth function, used as a cheap proxy for it
+ * @date   2017-9-4
+ */
+
+#ifndef NUMERICAL_ANALYSIS_CHEBYSHEV_HPP
+#define NUMERICAL_ANALYSIS_CHEBYSHEV_HPP
+
+#include "FunctionUtils.hpp"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+//! Chebyshev interpolant of a smooth function in an interval [a, b]. The
+//! function is sampled once, at Chebyshev points, and afterwards its integral,
+//! derivative, roots and minimum are computed from the coefficients alone.
+//! The interpolant is itself a callable, so it can be given to any method of
+//! the optimizer in place of the original function.
+//! \tparam T the scalar type of the function
+template<typename T>
+class BasicChebyshev {
+ private:
+  typedef BasicFunctionUtils<T> Utils;
+
+  //! degree above which root finding splits the interval in two
+  static const int maxColleagueDegree = 50;
+
+  T a, b;
+  //! coefficients of the Chebyshev polynomials T_0, T_1, ..., in [-1, 1]
+  vector<T> coefficients;
+  bool converged = true;
+
+  static T pi() {
+    return acos(T(- 1));
+  }
+
+  //! \return x in [a, b] mapped to [-1, 1]
+  T toUnit(T x) const {
+    return (2 * x - a - b) / (b - a);
+  }
+
+  //! \return t in [-1, 1] mapped to [a, b]
+  T fromUnit(T t) const {
+    return (a + b) / 2 + (b - a) / 2 * t;
+  }
+
+  //! In-place radix-2 fast Fourier transform
+  //! \param data a vector whose size is a power of 2
+  static void fft(vector<complex<T>> &data) {
+    size_t n = data.size();
+    for (size_t i = 1, j = 0; i < n; i ++) {
+      size_t bit = n >> 1;
+      for (; j & bit; bit >>= 1)
+        j ^= bit;
+      j ^= bit;
+      if (i < j)
+        swap(data[i], data[j]);
+    }
+
+    for (size_t length = 2; length <= n; length <<= 1) {
+      T angle = - 2 * pi() / length;
+      complex<T> root(cos(angle), sin(angle));
+      for (size_t i = 0; i < n; i += length) {
+        complex<T> w(1);
+        for (size_t j = 0; j < length / 2; j ++) {
+          complex<T> u = data[i + j], v = data[i + j + length / 2] * w;
+          data[i + j] = u + v;
+          data[i + j + length / 2] = u - v;
+          w *= root;
+        }
+      }
+    }
+  }
+
+  //! Computes the Chebyshev coefficients of the interpolant through n + 1 values
+  //! at the Chebyshev points cos(pi j / n), using a discrete cosine transform
+  //! computed by an FFT of the even extension of the values
+  //! \param values the values of the function at the Chebyshev points
+  //! \return the n + 1 coefficients of the interpolant
+  static vector<T> valuesToCoefficients(const vector<T> &values) {
+    size_t n = values.size() - 1;
+    if (n == 0)
+      return values;
+
+    vector<complex<T>> extension(2 * n);
+    for (size_t j = 0; j <= n; j ++)
+      extension[j] = values[j];
+    for (size_t j = 1; j < n; j ++)
+      extension[2 * n - j] = values[j];
+
+    fft(extension);
+
+    vector<T> result(n + 1);
+    for (size_t k = 0; k <= n; k ++)
+      result[k] = extension[k].real() / n;
+    result[0] /= 2;
+    result[n] /= 2;
+    return result;
+  }
+
+  //! \return the largest absolute value among the coefficients
+  T scale() const {
+    T largest = 0;
+    for (T c : coefficients)
+      largest = max(largest, fabs(c));
+    return largest;
+  }
+
+  //! Removes trailing coefficients which are negligible relative to the largest one
+  void trim(T tolerance) {
+    T threshold = tolerance * scale();
+    while (coefficients.size() > 1 and fabs(coefficients.back()) <= threshold)
+      coefficients.pop_back();
+  }
+
+  //! Balances a square matrix by a diagonal similarity transform, which leaves
+  //! its eigenvalues unchanged but makes them less sensitive to rounding. Each
+  //! row and its column are repeatedly scaled by a power of 2 (so no rounding is
+  //! introduced) that brings their off-diagonal norms closer together
+  //! \param m the matrix
+  static void balance(vector<vector<T>> &m) {
+    size_t n = m.size();
+    bool changed = true;
+    for (int sweep = 0; changed and sweep < 100; sweep ++) {
+      changed = false;
+      for (size_t i = 0; i < n; i ++) {
+        T row = 0, column = 0;
+        for (size_t j = 0; j < n; j ++)
+          if (j != i) {
+            row += fabs(m[i][j]);
+            column += fabs(m[j][i]);
+          }
+        if (row == 0 or column == 0)
+          continue;
+
+        // the power of 2 closest to sqrt(row / column) equalizes both norms
+        int exponent = (int) lround(log2(row / column) / 2);
+        T factor = ldexp(T(1), exponent);
+        if (exponent == 0 or column * factor + row / factor >= T(0.95) * (column + row))
+          continue;
+
+        for (size_t j = 0; j < n; j ++) {
+          m[i][j] /= factor;
+          m[j][i] *= factor;
+        }
+        changed = true;
+      }
+    }
+  }
+
+  //! Eigenvalues of an upper Hessenberg matrix, via the QR algorithm with
+  //! single complex shifts. Every step factors the active block, minus the
+  //! Wilkinson shift, into Givens rotations and a triangular matrix and multiplies
+  //! them back in reverse order. Eigenvalues are deflated from the bottom of the
+  //! block once the subdiagonal element above them becomes negligible
+  //! \param m the matrix, which is destroyed
+  //! \return the eigenvalues
+  static vector<complex<T>> hessenbergEigenvalues(vector<vector<complex<T>>> &m) throw(runtime_error) {
+    int n = (int) m.size();
+    vector<complex<T>> eigenvalues(n);
+    vector<complex<T>> cosines(n), sines(n);
+    int iterations = 0;
+
+    // scale of the matrix, used where the diagonal elements are zero
+    T norm = 0;
+    for (int i = 0; i < n; i ++)
+      for (int j = 0; j < n; j ++)
+        norm += abs(m[i][j]);
+
+    for (int high = n - 1; high >= 0;) {
+      // the active block starts below the last negligible subdiagonal element
+      int low = high;
+      for (; low > 0; low --) {
+        T diagonal = abs(m[low - 1][low - 1]) + abs(m[low][low]);
+        if (abs(m[low][low - 1]) <= Utils::machineEpsilon * (diagonal == 0 ? norm : diagonal))
+          break;
+      }
+      if (low > 0)
+        m[low][low - 1] = 0;
+
+      if (low == high) {
+        eigenvalues[high --] = m[low][low];
+        iterations = 0;
+        continue;
+      }
+      if (++ iterations > 30 * n)
+        throw runtime_error("The QR algorithm did not converge");
+
+      // eigenvalue of the trailing 2x2 block closest to its last diagonal element,
+      // replaced by an arbitrary shift from time to time to break cycles
+      complex<T> a = m[high - 1][high - 1], b = m[high - 1][high], c = m[high][high - 1], d = m[high][high];
+      complex<T> shift;
+      if (iterations % 11 == 0)
+        shift = d + abs(c);
+      else {
+        complex<T> half = (a - d) / T(2), root = sqrt(half * half + b * c);
+        shift = abs(half + root) > abs(half - root) ? d - b * c / (half + root) : d - b * c / (half - root);
+        if (not isfinite(shift.real()) or not isfinite(shift.imag()))
+          shift = d;
+      }
+
+      for (int k = low; k <= high; k ++)
+        m[k][k] -= shift;
+
+      // QR factorization, zeroing the subdiagonal with a rotation of each pair of rows
+      for (int k = low; k < high; k ++) {
+        complex<T> x = m[k][k], y = m[k + 1][k];
+        T norm = hypot(abs(x), abs(y));
+        cosines[k] = norm == 0 ? complex<T>(1) : x / norm;
+        sines[k] = norm == 0 ? complex<T>(0) : y / norm;
+        for (int j = k; j <= high; j ++) {
+          complex<T> upper = m[k][j], lower = m[k + 1][j];
+          m[k][j] = conj(cosines[k]) * upper + conj(sines[k]) * lower;
+          m[k + 1][j] = cosines[k] * lower - sines[k] * upper;
+        }
+      }
+
+      // multiplication of the triangular factor by the transposed rotations, on the right
+      for (int k = low; k < high; k ++)
+        for (int i = low; i <= k + 1; i ++) {
+          complex<T> left = m[i][k], right = m[i][k + 1];
+          m[i][k] = left * cosines[k] + right * sines[k];
+          m[i][k + 1] = right * conj(cosines[k]) - left * conj(sines[k]);
+        }
+
+      for (int k = low; k <= high; k ++)
+        m[k][k] += shift;
+    }
+    return eigenvalues;
+  }
+
+  //! Roots in [-1, 1] of the interpolant, as eigenvalues of its colleague matrix
+  //! \return the roots, mapped to [a, b]
+  vector<T> colleagueRoots() const {
+    vector<T> roots;
+    int n = (int) coefficients.size() - 1;
+    while (n > 0 and coefficients[n] == 0)
+      n --;
+    if (n < 1)
+      return roots;
+
+    vector<T> unitRoots;
+    if (n == 1)
+      unitRoots.push_back(- coefficients[0] / coefficients[1]);
+    else {
+      // the transpose of the colleague matrix, which is upper Hessenberg
+      vector<vector<T>> m(n, vector<T>(n, 0));
+      m[1][0] = 1;
+      for (int i = 1; i < n - 1; i ++) {
+        m[i - 1][i] = T(0.5);
+        m[i + 1][i] = T(0.5);
+      }
+      m[n - 2][n - 1] = T(0.5);
+      for (int j = 0; j < n; j ++)
+        m[j][n - 1] -= coefficients[j] / (2 * coefficients[n]);
+
+      // balancing scales rows and columns together, so the matrix stays upper Hessenberg
+      balance(m);
+      vector<vector<complex<T>>> hessenberg(n, vector<complex<T>>(n));
+      for (int i = 0; i < n; i ++)
+        for (int j = 0; j < n; j ++)
+          hessenberg[i][j] = m[i][j];
+
+      for (const complex<T> &eigenvalue : hessenbergEigenvalues(hessenberg))
+        if (fabs(eigenvalue.imag()) <= Utils::sqrtMachineEpsilon)
+          unitRoots.push_back(eigenvalue.real());
+    }
+
+    for (T t : unitRoots)
+      if (fabs(t) <= 1 + Utils::sqrtMachineEpsilon)
+        roots.push_back(fromUnit(max(T(- 1), min(T(1), t))));
+    return roots;
+  }
+
+  //! Recursively splits the interval until the interpolant is of low degree,
+  //! then finds the roots of each piece from its colleague matrix
+  //! \param depth number of splits done so far
+  //! \return the roots in [a, b]
+  vector<T> subdividedRoots(int depth) const {
+    if ((int) coefficients.size() - 1 <= maxColleagueDegree or depth >= 20)
+      return colleagueRoots();
+
+    // splits slightly off the middle, so that roots at the middle aren't found twice
+    T middle = fromUnit(T(- 0.004849834917525));
+    function<T(T)> self = [this](T x) { return (*this)(x); };
+    T tolerance = Utils::machineEpsilon * 100;
+
+    vector<T> roots = BasicChebyshev(self, a, middle, tolerance, coefficients.size()).subdividedRoots(depth + 1);
+    vector<T> right = BasicChebyshev(self, middle, b, tolerance, coefficients.size()).subdividedRoots(depth + 1);
+    roots.insert(roots.end(), right.begin(), right.end());
+    return roots;
+  }
+
+ public:
+  //! Builds the interpolant of a function, doubling the number of Chebyshev
+  //! points (and reusing the previous samples) until the trailing coefficients
+  //! become negligible
+  //! \param f the function to approximate, which is evaluated in parallel
+  //! \param a the lower bound of the interval
+  //! \param b the upper bound of the interval
+  //! \param tolerance relative size of the coefficients considered negligible
+  //! \param maxDegree the maximum degree of the interpolant
+  BasicChebyshev(const function<T(T)> &f, T a, T b,
+                 T tolerance = Utils::machineEpsilon * 100, size_t maxDegree = 65536) throw(runtime_error)
+      : a(a), b(b) {
+    if (a >= b)
+      throw runtime_error("Lower bound of interpolation >= Higher bound");
+
+    size_t n = 16;
+    vector<T> values(n + 1);
+#pragma omp parallel for
+    for (long int j = 0; j <= (long int) n; j ++)
+      values[j] = f(fromUnit(cos(pi() * j / n)));
+
+    while (true) {
+      coefficients = valuesToCoefficients(values);
+
+      // the function is resolved when the last eighth of the coefficients is negligible
+      T threshold = tolerance * scale();
+      size_t tail = max((size_t) 2, n / 8);
+      converged = true;
+      for (size_t k = n + 1 - tail; k <= n; k ++)
+        converged = converged and fabs(coefficients[k]) <= threshold;
+
+      if (converged or 2 * n > maxDegree)
+        break;
+
+      // the Chebyshev points of degree n are the even points of degree 2n
+      vector<T> refined(2 * n + 1);
+      for (size_t j = 0; j <= n; j ++)
+        refined[2 * j] = values[j];
+#pragma omp parallel for
+      for (long int j = 1; j < 2 * (long int) n; j += 2)
+        refined[j] = f(fromUnit(cos(pi() * j / (2 * n))));
+
+      values.swap(refined);
+      n *= 2;
+    }
+
+    trim(tolerance);
+  }
+
+  //! Builds an interpolant from previously computed coefficients
+  //! \param a the lower bound of the interval
+  //! \param b the upper bound of the interval
+  //! \param coefficients the coefficients of the Chebyshev polynomials T_0, T_1, ...
+  BasicChebyshev(T a, T b, const vector<T> &coefficients) throw(runtime_error)
+      : a(a), b(b), coefficients(coefficients) {
+    if (a >= b)
+      throw runtime_error("Lower bound of interpolation >= Higher bound");
+    if (coefficients.empty())
+      this->coefficients.push_back(0);
+  }
+
+  //! Evaluates the interpolant via Clenshaw's recurrence
+  //! \param x a point in [a, b]
+  //! \return the value of the interpolant at x
+  T operator()(T x) const {
+    T t = toUnit(x), b1 = 0, b2 = 0;
+    for (size_t k = coefficients.size() - 1; k >= 1; k --) {
+      T b0 = coefficients[k] + 2 * t * b1 - b2;
+      b2 = b1;
+      b1 = b0;
+    }
+    return coefficients[0] + t * b1 - b2;
+  }
+
+  T getLowerBound() const { return a; }
+
+  T getUpperBound() const { return b; }
+
+  //! \return the coefficients of the Chebyshev polynomials T_0, T_1, ..., which
+  //! can be stored and given back to the constructor
+  const vector<T> &getCoefficients() const { return coefficients; }
+
+  //! \return the degree of the interpolant
+  size_t getDegree() const { return coefficients.size() - 1; }
+
+  //! \return false if the maximum degree was reached before the coefficients became negligible
+  bool isConverged() const { return converged; }
+
+  //! Integral of the interpolant in [a, b] via Clenshaw-Curtis quadrature
+  //! \return the integral of the interpolant
+  T integral() const {
+    T sum = 0;
+    for (size_t k = 0; k < coefficients.size(); k += 2)
+      sum += coefficients[k] * 2 / (1 - T(k * k));
+    return sum * (b - a) / 2;
+  }
+
+  //! Integral of the interpolant in a sub-interval
+  //! \param low the lower bound of the integration interval
+  //! \param high the upper bound of the integration interval
+  //! \return the integral of the interpolant between low and high
+  T integral(T low, T high) const {
+    BasicChebyshev primitive = antiderivative();
+    return primitive(high) - primitive(low);
+  }
+
+  //! \return the antiderivative of the interpolant which is zero at a
+  BasicChebyshev antiderivative() const {
+    size_t n = coefficients.size();
+    vector<T> c(coefficients), result(n + 1, 0);
+    c.resize(n + 2, 0);
+
+    result[1] = c[0] - c[2] / 2;
+    for (size_t k = 2; k <= n; k ++)
+      result[k] = (c[k - 1] - c[k + 1]) / (2 * k);
+
+    // chooses the constant term so that the antiderivative is zero at t = -1
+    T atLowerBound = 0;
+    for (size_t k = 1; k <= n; k ++)
+      atLowerBound += k % 2 == 0 ? result[k] : - result[k];
+    result[0] = - atLowerBound;
+
+    for (T &r : result)
+      r *= (b - a) / 2;
+    return BasicChebyshev(a, b, result);
+  }
+
+  //! \return the derivative of the interpolant
+  BasicChebyshev derivative() const {
+    size_t n = coefficients.size() - 1;
+    if (n == 0)
+      return BasicChebyshev(a, b, vector<T>(1, 0));
+
+    vector<T> result(n + 1, 0);
+    for (size_t k = n; k >= 1; k --)
+      result[k - 1] = (k + 1 <= n ? result[k + 1] : 0) + 2 * k * coefficients[k];
+    result[0] /= 2;
+    result.pop_back();
+
+    for (T &r : result)
+      r *= 2 / (b - a);
+    return BasicChebyshev(a, b, result);
+  }
+
+  //! Finds all roots of the interpolant in [a, b]. Each piece of the interval
+  //! is solved as the eigenvalues of its colleague matrix, and the roots are
+  //! then polished with a few Newton steps
+  //! \return the roots, in increasing order
+  vector<T> roots() const {
+    vector<T> found = subdividedRoots(0);
+    BasicChebyshev slope = derivative();
+
+    for (T &x : found)
+      for (int i = 0; i < 3; i ++) {
+        T d = slope(x);
+        if (d == 0)
+          break;
+        T next = x - (*this)(x) / d;
+        if (next < a or next > b)
+          break;
+        x = next;
+      }
+
+    sort(found.begin(), found.end());
+    vector<T> unique;
+    for (T x : found)
+      if (unique.empty() or x - unique.back() > Utils::sqrtMachineEpsilon * (b - a))
+        unique.push_back(x);
+    return unique;
+  }
+
+  //! Finds the global minimum of the interpolant in [a, b], among the roots of
+  //! its derivative and the bounds of the interval
+  //! \return the point at which the interpolant is minimal
+  T minimum() const {
+    vector<T> candidates = derivative().roots();
+    candidates.push_back(a);
+    candidates.push_back(b);
+
+    T best = a;
+    for (T x : candidates)
+      if ((*this)(x) < (*this)(best))
+        best = x;
+    return best;
+  }
+};
+
+template<typename T>
+const int BasicChebyshev<T>::maxColleagueDegree;
+
+typedef BasicChebyshev<double> Chebyshev;
+
+#endif //NUMERICAL_ANALYSIS_CHEBYSHEV_HPP
@@ -14,19 +14,27 @@
 using namespace std;
 
 //! Utility functions for numerical functions
-class FunctionUtils {
- private:
-  //! A shortcut for the root of the machine epsilon, used for calculating a
+//! \tparam T the scalar type in which functions are evaluated (float, double or long double)
+template<typename T>
+class BasicFunctionUtils {
+ public:
+  //! The machine epsilon of the scalar type T
+  static T const machineEpsilon;
+
+  //! A shortcut for the root of the machine epsilon of T, used for calculating a
   //! small but precise value for h in the derivatives
-  static double const sqrtMachineEpsilon;
+  static T const sqrtMachineEpsilon;
+
+  //! Default tolerance of the iterative quadratures, between the root of the machine
+  //! epsilon and the epsilon itself, so that refinement ends before rounding errors dominate
+  static T const quadratureTolerance;
 
- public:
   //! Numerically approximates the derivative of a single-variable function
   //! \param f a function
   //! \param x the point at which the derivative is to be calculated
   //! \return the derivative of the function
-  static double derivative(const function<double(double)> &f, double x) {
-    double h = sqrtMachineEpsilon * x;
+  static T derivative(const function<T(T)> &f, T x) {
+    T h = sqrtMachineEpsilon * x;
     return (f(x + h) - f(x)) / h;
   }
 
@@ -36,9 +44,9 @@ class FunctionUtils {
   //! \param y the second point at which the derivative is to be calculated
   //! \param which 0 to differentiate x, otherwise y
   //! \return the partial derivative of the function
-  static double partialDerivative(const function<double(double, double)> &f, double x,
-                                  double y, int which = 0) {
-    double h = sqrtMachineEpsilon;
+  static T partialDerivative(const function<T(T, T)> &f, T x,
+                             T y, int which = 0) {
+    T h = sqrtMachineEpsilon;
     if (which == 0) {
       h *= x;
       return (f(x, y) - f(x - h, y)) / h;
@@ -52,7 +60,7 @@ class FunctionUtils {
   //! \param a the lower bound of the interval
   //! \param b the upper bound of the interval
   //! \return numerical approximation of f between a and b according to the rectangle rule
-  static double rectangleRule(const std::function<double(double)> &f, double a, double b) {
+  static T rectangleRule(const std::function<T(T)> &f, T a, T b) {
     return (b - a) * f((a + b) / 2);
   }
 
@@ -62,7 +70,7 @@ class FunctionUtils {
   //! \param b the upper bound of the interval
   //! \return numerical approximation of f between a and b according to the trapezoid rule
 
-  static double trapezoidRule(const std::function<double(double)> &f, double a, double b) {
+  static T trapezoidRule(const std::function<T(T)> &f, T a, T b) {
     return (b - a) * (f(a) + f(b)) / 2;
   }
 
@@ -71,10 +79,21 @@ class FunctionUtils {
   //! \param a the lower bound of the interval
   //! \param b the upper bound of the interval
   //! \return numerical approximation of f between a and b according to Simpson's rule
-  static double simpsonRule(const std::function<double(double)> &f, double a, double b) {
+  static T simpsonRule(const std::function<T(T)> &f, T a, T b) {
     return (b - a) * (f(a) + 4 * f((a + b) / 2) + f(b)) / 6;
   }
 };
 
-const double FunctionUtils::sqrtMachineEpsilon = sqrt(numeric_limits<double>::epsilon());
+template<typename T>
+const T BasicFunctionUtils<T>::machineEpsilon = numeric_limits<T>::epsilon();
+
+template<typename T>
+const T BasicFunctionUtils<T>::sqrtMachineEpsilon = sqrt(numeric_limits<T>::epsilon());
+
+template<typename T>
+const T BasicFunctionUtils<T>::quadratureTolerance = pow(numeric_limits<T>::epsilon(), T(0.75));
+
+//! Utility functions in double precision
+typedef BasicFunctionUtils<double> FunctionUtils;
+
 #endif
@@ -0,0 +1,286 @@
+/**
+ * @author Douglas De Rizzo Meneghetti (douglasrizzom@gmail.com)
+ * @brief  Partial results of Monte Carlo methods, which can be serialized and merged
+ * @date   2017-8-28
+ */
+
+#ifndef NUMERICAL_ANALYSIS_MONTECARLOPARTIAL_HPP
+#define NUMERICAL_ANALYSIS_MONTECARLOPARTIAL_HPP
+
+#include "VolumousObject.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+//! Sufficient statistics of a Monte Carlo integration or volume estimation.
+//! The samples are drawn in blocks, each one from its own random stream, so
+//! partial results computed on disjoint blocks (e.g. by different processes)
+//! can be merged into the exact result of a single run over all blocks.
+//! \tparam A the scalar type in which sums are accumulated
+template<typename A>
+class BasicMonteCarloPartial {
+ public:
+  enum Kind { INTEGRATION, VOLUME };
+
+  //! a half-open range [first, last) of block indices
+  typedef pair<uint64_t, uint64_t> BlockRange;
+
+  //! version of the binary format written by serialize()
+  static const uint8_t formatVersion = 3;
+
+ private:
+  Kind kind;
+  // the total number of samples of the process, which determines the size of its last block
+  uint64_t seed, blockSize, points;
+  // bounds of the integration interval, or of the enclosing cube in the x, y and z axes
+  vector<A> bounds;
+  // width of the integration interval or volume of the enclosing cube
+  A domain;
+  uint64_t count = 0, insideCount = 0;
+  A sum = 0, squaredSum = 0, xSum = 0, ySum = 0, zSum = 0;
+  // sorted, non-overlapping ranges of the blocks whose samples were accumulated
+  vector<BlockRange> blocks;
+
+  template<typename V>
+  static void write(string &out, V value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(V));
+  }
+
+  template<typename V>
+  static V read(const string &in, size_t &pos) {
+    if (pos + sizeof(V) > in.size())
+      throw runtime_error("Truncated Monte Carlo partial result");
+    V value;
+    memcpy(&value, in.data() + pos, sizeof(V));
+    pos += sizeof(V);
+    return value;
+  }
+
+ public:
+  //! \param kind whether the samples estimate an integral or a volume
+  //! \param seed the seed of the random streams of the process
+  //! \param blockSize number of samples drawn from each random stream
+  //! \param points the total number of samples of the process, split among all partial results
+  //! \param bounds {low, high} of the integration interval, or {xLow, xHigh, yLow, yHigh,
+  //! zLow, zHigh} of the enclosing cube
+  BasicMonteCarloPartial(Kind kind, uint64_t seed, uint64_t blockSize, uint64_t points,
+                         const vector<A> &bounds) throw(runtime_error)
+      : kind(kind), seed(seed), blockSize(blockSize), points(points), bounds(bounds) {
+    if (bounds.size() != boundCount(kind))
+      throw runtime_error("A Monte Carlo partial result needs " + to_string(boundCount(kind)) + " bounds");
+    domain = 1;
+    for (size_t i = 0; i < bounds.size(); i += 2)
+      domain *= bounds[i + 1] - bounds[i];
+  }
+
+  //! \return number of bounds of the domain of a kind of process
+  static size_t boundCount(Kind kind) {
+    return kind == INTEGRATION ? 2 : 6;
+  }
+
+  Kind getKind() const { return kind; }
+
+  uint64_t getSeed() const { return seed; }
+
+  uint64_t getBlockSize() const { return blockSize; }
+
+  //! \return the total number of samples of the process this partial result belongs to
+  uint64_t getPoints() const { return points; }
+
+  //! \return width of the integration interval or volume of the enclosing cube
+  A getDomain() const { return domain; }
+
+  //! \return bounds of the integration interval, or of the enclosing cube in the x, y and z axes
+  const vector<A> &getBounds() const { return bounds; }
+
+  //! \return number of samples drawn
+  uint64_t getCount() const { return count; }
+
+  //! \return number of samples which fell inside the object
+  uint64_t getInsideCount() const { return insideCount; }
+
+  //! \return ranges of the random streams (blocks) whose samples were accumulated
+  const vector<BlockRange> &getBlocks() const { return blocks; }
+
+  //! Accumulates the sums of the samples of a range of blocks
+  //! \param range the blocks that generated the samples
+  //! \param samples number of samples in the blocks
+  //! \param inside number of samples inside the object (volume only)
+  //! \param sum sum of the function values (integration only)
+  //! \param squaredSum sum of the squared function values (integration only)
+  //! \param xSum sum of the x coordinates of the samples inside the object (volume only)
+  //! \param ySum sum of the y coordinates of the samples inside the object (volume only)
+  //! \param zSum sum of the z coordinates of the samples inside the object (volume only)
+  void add(const BlockRange &range, uint64_t samples, uint64_t inside,
+           A sum, A squaredSum, A xSum, A ySum, A zSum) {
+    if (range.first == range.second)
+      return;
+    BasicMonteCarloPartial other(kind, seed, blockSize, points, bounds);
+    other.blocks.push_back(range);
+    other.count = samples;
+    other.insideCount = inside;
+    other.sum = sum;
+    other.squaredSum = squaredSum;
+    other.xSum = xSum;
+    other.ySum = ySum;
+    other.zSum = zSum;
+    merge(other);
+  }
+
+  //! Merges the samples of another partial result into this one. Merging is
+  //! associative and commutative, apart from floating-point rounding
+  //! \param other a partial result of the same process, computed on different blocks
+  //! \return this partial result
+  BasicMonteCarloPartial &merge(const BasicMonteCarloPartial &other) {
+    if (kind != other.kind or seed != other.seed or blockSize != other.blockSize or points != other.points
+        or bounds != other.bounds)
+      throw runtime_error("Monte Carlo partial results come from different processes");
+
+    vector<BlockRange> merged;
+    merged.reserve(blocks.size() + other.blocks.size());
+    std::merge(blocks.begin(), blocks.end(), other.blocks.begin(), other.blocks.end(), back_inserter(merged));
+
+    // overlapping blocks would count the same samples twice, adjacent ones are coalesced
+    vector<BlockRange> coalesced;
+    for (const BlockRange &range : merged) {
+      if (not coalesced.empty() and range.first < coalesced.back().second)
+        throw runtime_error("Monte Carlo partial results share random streams");
+      if (not coalesced.empty() and range.first == coalesced.back().second)
+        coalesced.back().second = range.second;
+      else
+        coalesced.push_back(range);
+    }
+    blocks = coalesced;
+
+    count += other.count;
+    insideCount += other.insideCount;
+    sum += other.sum;
+    squaredSum += other.squaredSum;
+    xSum += other.xSum;
+    ySum += other.ySum;
+    zSum += other.zSum;
+    return *this;
+  }
+
+  //! \return estimated integral, i.e. the mean of the samples times the width of the interval
+  A getIntegral() const {
+    return domain * sum / count;
+  }
+
+  //! \return standard deviation of the estimated integral
+  A getIntegralError() const {
+    A mean = sum / count;
+    return domain * sqrt(fabs(squaredSum / count - mean * mean) / count);
+  }
+
+  //! \return estimated volume, i.e. the fraction of samples inside the object times the volume of the cube
+  A getVolume() const {
+    return domain * insideCount / count;
+  }
+
+  //! \return standard deviation of the estimated volume
+  A getVolumeError() const {
+    // according to Numerical Recipes, a suitable error measure is +/- 1 standard deviation
+    A pctInside = insideCount / (A) count;
+    return domain * sqrt((pctInside - pctInside * pctInside) / count);
+  }
+
+  //! \return the object described by the samples
+  BasicVolumousObject<A> toVolumousObject() const {
+    BasicVolumousObject<A> obj;
+    obj.setVolume(getVolume());
+    //weight due to gravity
+    obj.setWeight(obj.getVolume());
+    obj.setError(getVolumeError());
+
+    // center of mass in the three coordinates
+    // density = 1 everywhere, so it's a straightforward sum
+    obj.getCenterOfMass().setX(xSum / insideCount);
+    obj.getCenterOfMass().setY(ySum / insideCount);
+    obj.getCenterOfMass().setZ(zSum / insideCount);
+    return obj;
+  }
+
+  //! Serializes the partial result in a compact binary format, in the byte
+  //! order of the machine. Partial results can only be read back by programs
+  //! using the same scalar type
+  //! \return the bytes of the partial result
+  string serialize() const {
+    string out("NAMC");
+    write<uint8_t>(out, formatVersion);
+    write<uint8_t>(out, (uint8_t) kind);
+    write<uint8_t>(out, (uint8_t) sizeof(A));
+    write(out, seed);
+    write(out, blockSize);
+    write(out, points);
+    write(out, count);
+    write(out, insideCount);
+    for (A bound : bounds)
+      write(out, bound);
+    for (A value : {sum, squaredSum, xSum, ySum, zSum})
+      write(out, value);
+    write<uint64_t>(out, blocks.size());
+    for (const BlockRange &range : blocks) {
+      write(out, range.first);
+      write(out, range.second);
+    }
+    return out;
+  }
+
+  //! Reads a partial result written by serialize(), checking that its block
+  //! ranges are sorted and don't overlap, as merge() expects
+  //! \param in the bytes of the partial result
+  //! \return the partial result
+  static BasicMonteCarloPartial deserialize(const string &in) {
+    if (in.compare(0, 4, "NAMC") != 0)
+      throw runtime_error("Not a Monte Carlo partial result");
+    size_t pos = 4;
+    uint8_t version = read<uint8_t>(in, pos);
+    if (version != formatVersion)
+      throw runtime_error("Unsupported Monte Carlo partial result version " + to_string(version));
+    uint8_t kind = read<uint8_t>(in, pos);
+    if (kind != INTEGRATION and kind != VOLUME)
+      throw runtime_error("Unknown kind of Monte Carlo partial result " + to_string(kind));
+    if (read<uint8_t>(in, pos) != sizeof(A))
+      throw runtime_error("Monte Carlo partial result was written with a different scalar type");
+
+    uint64_t seed = read<uint64_t>(in, pos), blockSize = read<uint64_t>(in, pos), points = read<uint64_t>(in, pos);
+    uint64_t count = read<uint64_t>(in, pos), insideCount = read<uint64_t>(in, pos);
+
+    vector<A> bounds;
+    for (size_t i = 0; i < boundCount((Kind) kind); i ++)
+      bounds.push_back(read<A>(in, pos));
+
+    BasicMonteCarloPartial partial((Kind) kind, seed, blockSize, points, bounds);
+    partial.count = count;
+    partial.insideCount = insideCount;
+    partial.sum = read<A>(in, pos);
+    partial.squaredSum = read<A>(in, pos);
+    partial.xSum = read<A>(in, pos);
+    partial.ySum = read<A>(in, pos);
+    partial.zSum = read<A>(in, pos);
+
+    uint64_t ranges = read<uint64_t>(in, pos);
+    for (uint64_t i = 0; i < ranges; i ++) {
+      uint64_t first = read<uint64_t>(in, pos), last = read<uint64_t>(in, pos);
+      if (first >= last or (not partial.blocks.empty() and first < partial.blocks.back().second))
+        throw runtime_error("Monte Carlo partial result has unsorted or overlapping blocks");
+      partial.blocks.emplace_back(first, last);
+    }
+    return partial;
+  }
+};
+
+template<typename A>
+const uint8_t BasicMonteCarloPartial<A>::formatVersion;
+
+typedef BasicMonteCarloPartial<double> MonteCarloPartial;
+
+#endif //NUMERICAL_ANALYSIS_MONTECARLOPARTIAL_HPP
@@ -9,45 +9,236 @@
 
 #include "FunctionUtils.hpp"
 #include "VolumousObject.hpp"
+#include "AsyncTask.hpp"
+#include "MonteCarloPartial.hpp"
+#include "ThreadPool.hpp"
+#include "TraceRecorder.hpp"
+#include <algorithm>
 #include <cmath>
 #include <functional>
 #include <iostream>
 #include <random>
 #include <chrono>
+#include <vector>
 #include <omp.h>
 
 //! Numerical optimizer specialized in finding roots, minima and integrals of functions
-class Optimizer {
+//! \tparam T the scalar type in which functions are evaluated and random samples are generated
+//! \tparam A the scalar type in which sums are accumulated. Using a wider type than T
+//! (e.g. float samples with double accumulation) gives a mixed-precision mode
+template<typename T, typename A = T>
+class BasicOptimizer {
  public:
   enum IntegrationMethod { RECTANGLE, TRAPEZOID, SIMPSON };
 
+  //! Classification of a cell of the octree used by monteCarloVolumeOctree
+  enum CellClass { INSIDE_CELL, OUTSIDE_CELL, BOUNDARY_CELL };
+
+  //! Conservative test which classifies the cell {xLow, xHigh, yLow, yHigh, zLow, zHigh}
+  //! as fully inside or fully outside a region, or BOUNDARY_CELL when it can't tell
+  typedef function<CellClass(T, T, T, T, T, T)> CellTest;
+
+  typedef BasicFunctionUtils<T> Utils;
+
+  typedef BasicTraceRecorder<A> Trace;
+
+  //! number of samples drawn from each random stream by the Monte Carlo methods
+  static const long int samplesPerBlock = 16384;
+
  private:
-  int iterations = 0;
-  double error = 0;
+  //! iterations, quadratures or samples of the last optimization, which may exceed the range of an int
+  long int iterations = 0;
+  A error = 0;
+  //! generates the seeds of the Monte Carlo methods
   mt19937_64 myMersenne;
-  uniform_real_distribution<double> myUniformDistribution;
-  float executionTime{};
+  double executionTime{};
   string endReason = "You didn't run any optimization yet!";
+  //! progress of an asynchronous optimization, null for synchronous ones
+  ProgressMonitor<A> *monitor = nullptr;
+  //! integral and error of the sub-intervals already accepted by the adaptive quadrature
+  A adaptiveSum = 0, adaptiveError = 0;
+  //! recorder of the iterations, null when tracing is disabled
+  Trace *trace = nullptr;
+
+  //! \return true if the caller of an asynchronous optimization asked it to stop
+  bool cancelRequested() const {
+    return monitor != nullptr and monitor->isCancelled();
+  }
+
+  //! \return number of threads to use in parallel regions. Asynchronous optimizations
+  //! share the cores with the other jobs in the thread pool
+  int parallelThreads() const {
+    return monitor == nullptr ? omp_get_max_threads() : ThreadPool::instance().threadsPerJob();
+  }
 
-  //! Pseudo-random number generator using the Mersenne Twister method
-  //! \return double between 0 and 1
-  double myRandom() {
-    return myUniformDistribution(myMersenne);
+  //! \param total the number of samples of the whole process
+  //! \return number of samples to draw between two progress reports
+  long int chunkSize(long int total) const {
+    if (monitor != nullptr)
+      return monitor->getChunkSize();
+    // traced runs record a running estimate after every block drawn by each thread
+    return trace == nullptr ? total : samplesPerBlock;
   }
 
-  //! Pseudo-random number generator using the Mersenne Twister method
-  //! \param min the lower bound for the random number
-  //! \param max the upper bound for the random number
-  //! \return double between min and max
-  double myRandom(double min, double max) {
-    return myRandom() * (max - min) + min;
+  //! Runs an optimization in the shared thread pool, using a fresh optimizer
+  //! \param job the optimization to run
+  //! \param onProgress function called at every chunk boundary
+  //! \param chunk number of samples or iterations between two progress reports
+  //! \return a handle to the running optimization
+  template<typename R>
+  AsyncTask<R, A> runAsync(const function<R(BasicOptimizer &)> &job,
+                           const typename ProgressMonitor<A>::Callback &onProgress,
+                           long int chunk) {
+    typedef typename AsyncTask<R, A>::Outcome Outcome;
+
+    auto progress = make_shared<ProgressMonitor<A>>(onProgress, chunk);
+    auto task = make_shared<packaged_task<Outcome()>>([job, progress]() {
+      BasicOptimizer o;
+      o.monitor = progress.get();
+      R result = job(o);
+      return Outcome{result, o.iterations, o.error, o.endReason, o.executionTime};
+    });
+
+    shared_future<Outcome> outcome = task->get_future().share();
+    ThreadPool::instance().submit([task]() { (*task)(); });
+    return AsyncTask<R, A>(progress, outcome);
   }
 
-  //! Pseudo-random number generator using the Mersenne Twister method
-  //! \param max the upper bound for the random number
-  //! \return double between 0 and max
-  double myRandom(double max) {
-    return myRandom() * max;
+  typedef pair<long int, long int> Range;
+
+  //! A cell of the octree used by monteCarloVolumeOctree
+  struct Cell {
+    T xLow, xHigh, yLow, yHigh, zLow, zHigh;
+
+    A volume() const {
+      return (A) (xHigh - xLow) * (yHigh - yLow) * (zHigh - zLow);
+    }
+  };
+
+  //! Splits a cell into its eight octants
+  //! \param cell the cell to split
+  //! \param octants vector in which the octants are stored
+  static void splitCell(const Cell &cell, vector<Cell> &octants) {
+    T xMiddle = (cell.xLow + cell.xHigh) / 2, yMiddle = (cell.yLow + cell.yHigh) / 2,
+        zMiddle = (cell.zLow + cell.zHigh) / 2;
+    for (int i = 0; i < 8; i ++)
+      octants.push_back({i & 1 ? xMiddle : cell.xLow, i & 1 ? cell.xHigh : xMiddle,
+                         i & 2 ? yMiddle : cell.yLow, i & 2 ? cell.yHigh : yMiddle,
+                         i & 4 ? zMiddle : cell.zLow, i & 4 ? cell.zHigh : zMiddle});
+  }
+
+  //! Classifies a cell by testing a regular grid of probe points, including its
+  //! corners. The cell is considered inside or outside the region only if all
+  //! probes agree, so this is a heuristic which may miss features smaller than the grid
+  //! \param cell the cell to classify
+  //! \param isInside function that tells whether a point is inside the region
+  //! \param probesPerAxis number of probes along each axis of the cell
+  //! \return the class of the cell
+  static CellClass probeCell(const Cell &cell, const function<bool(T, T, T)> &isInside, int probesPerAxis) {
+    int inside = 0, total = probesPerAxis * probesPerAxis * probesPerAxis;
+    for (int i = 0; i < probesPerAxis; i ++)
+      for (int j = 0; j < probesPerAxis; j ++)
+        for (int k = 0; k < probesPerAxis; k ++) {
+          T x = cell.xLow + (cell.xHigh - cell.xLow) * i / (probesPerAxis - 1);
+          T y = cell.yLow + (cell.yHigh - cell.yLow) * j / (probesPerAxis - 1);
+          T z = cell.zLow + (cell.zHigh - cell.zLow) * k / (probesPerAxis - 1);
+          if (isInside(x, y, z))
+            inside ++;
+        }
+    return inside == total ? INSIDE_CELL : inside == 0 ? OUTSIDE_CELL : BOUNDARY_CELL;
+  }
+
+  //! Random number generator of a block of samples of the Monte Carlo methods.
+  //! Every block has its own stream, so results don't depend on which thread or
+  //! process drew the block
+  //! \param seed the seed of the whole process
+  //! \param block the index of the block
+  //! \return a Mersenne Twister seeded from both numbers
+  static mt19937_64 blockGenerator(uint64_t seed, uint64_t block) {
+    seed_seq sequence{(uint32_t) seed, (uint32_t) (seed >> 32), (uint32_t) block, (uint32_t) (block >> 32)};
+    return mt19937_64(sequence);
+  }
+
+  //! \param points the total number of samples
+  //! \param block the index of a block
+  //! \return the number of samples in the block, which is smaller for the last one
+  static long int blockSize(long int points, long int block) {
+    return min(points, (block + 1) * samplesPerBlock) - block * samplesPerBlock;
+  }
+
+  //! Splits the blocks of samples evenly among shards
+  //! \param points the total number of samples
+  //! \param shardIndex the index of the shard
+  //! \param shardCount the number of shards
+  //! \return the range [first, last) of blocks that belong to the shard
+  static Range shardBlocks(long int points, long int shardIndex, long int shardCount) throw(runtime_error) {
+    if (shardCount < 1 or shardIndex < 0 or shardIndex >= shardCount)
+      throw runtime_error("Shard " + to_string(shardIndex) + " out of " + to_string(shardCount) + " is invalid");
+
+    long int blocks = (points + samplesPerBlock - 1) / samplesPerBlock;
+    return {blocks * shardIndex / shardCount, blocks * (shardIndex + 1) / shardCount};
+  }
+
+  //! \param points the total number of samples
+  //! \return number of blocks to sample between two progress reports, enough to keep every thread busy
+  long int blocksPerChunk(long int points) const {
+    return max((long int) parallelThreads(), chunkSize(points) / samplesPerBlock);
+  }
+
+  //! Integrand of the tanh-sinh quadrature after the change of variables from
+  //! x in [a, b] to s in [-1, 1]. Infinite bounds are mapped by rational functions
+  //! of s. The distances from s to 1 and to -1 are given separately, since near
+  //! the bounds they are much more precise than 1 - s and 1 + s
+  //! \param f the function to integrate
+  //! \param a the lower bound of the integration interval, possibly -infinity
+  //! \param b the upper bound of the integration interval, possibly infinity
+  //! \param s the point in [-1, 1]
+  //! \param toHigh the distance from s to 1
+  //! \param toLow the distance from s to -1
+  //! \return f(x) dx/ds, or 0 if x can't be told apart from the bounds
+  A tanhSinhIntegrand(const function<T(T)> &f, T a, T b, T s, T toHigh, T toLow) const {
+    T x;
+    A jacobian;
+    if (not isinf(a) and not isinf(b)) {
+      T half = (b - a) / 2;
+      x = s < 0 ? a + half * toLow : b - half * toHigh;
+      jacobian = half;
+    } else if (not isinf(a)) {
+      x = a + toLow / toHigh;
+      jacobian = 2 / ((A) toHigh * toHigh);
+    } else if (not isinf(b)) {
+      x = b - toHigh / toLow;
+      jacobian = 2 / ((A) toLow * toLow);
+    } else {
+      x = s / (toHigh * toLow);
+      jacobian = (1 + (A) s * s) / ((A) toHigh * toLow * toHigh * toLow);
+    }
+
+    // nodes which collapse onto a bound, where the integrand may be singular, have negligible weight
+    if (not isfinite(x) or x <= a or x >= b)
+      return 0;
+    T value = f(x);
+    return isfinite(value) ? value * jacobian : 0;
+  }
+
+  //! Sum of the terms of the tanh-sinh quadrature at the nodes t and -t
+  //! \param f the function to integrate
+  //! \param a the lower bound of the integration interval
+  //! \param b the upper bound of the integration interval
+  //! \param t a non-negative node of the quadrature
+  //! \return the weighted values of the integrand at the nodes
+  A tanhSinhNodes(const function<T(T)> &f, T a, T b, T t) const {
+    T halfPi = acos(T(0));
+    T u = halfPi * sinh(t);
+    // s = tanh(u) = (1 - e) / (1 + e), written so that 1 - s doesn't lose precision
+    T e = exp(- 2 * u);
+    T s = (1 - e) / (1 + e), toOne = 2 * e / (1 + e), toMinusOne = 2 / (1 + e);
+    A weight = halfPi * cosh(t) * 4 * e / ((1 + e) * (1 + e));
+
+    if (t == 0)
+      return weight * tanhSinhIntegrand(f, a, b, 0, 1, 1);
+    return weight * (tanhSinhIntegrand(f, a, b, s, toOne, toMinusOne) +
+        tanhSinhIntegrand(f, a, b, - s, toMinusOne, toOne));
   }
 
   //! Adaptive quadrature recursive method
@@ -56,24 +247,35 @@ class Optimizer {
   //! \param b the upper bound of the integration interval
   //! \param method the Newton-Cotes function to use in the approximation
   //! \param error
+  //! \param depth the depth of the recursion
   //! \return Numerical approximation of the integral of f
-  double innerAdaptiveIntegration(const function<double(double)> &f, double a,
-                                  double b, IntegrationMethod method,
-                                  double error = 1e-12) {
+  A innerAdaptiveIntegration(const function<T(T)> &f, T a,
+                             T b, IntegrationMethod method,
+                             A error = Utils::quadratureTolerance, int depth = 0) {
     iterations += 2;
     // calculates the middle point between a and b
-    double meio = (b + a) / 2;
+    T meio = (b + a) / 2;
     // uses the integrate method to calculate the value of a single quadrature
     // vs. the sum of two sub-quadratures
-    double i1 = integrate(f, a, b, 1, method),
+    A i1 = integrate(f, a, b, 1, method),
         i2 = integrate(f, a, meio, 1, method) +
         integrate(f, meio, b, 1, method);
 
+    if (trace != nullptr and trace->sample())
+      trace->record({Trace::ADAPTIVE_QUADRATURE, depth, iterations, a, b, i2, Trace::missing(),
+                     Trace::missing(), fabs(i1 - i2)});
+
     // if there is error, run adaptive integration in the two sub-divisions of
-    // the current partition
-    if (fabs(i1 - i2) > error) {
-      return innerAdaptiveIntegration(f, a, meio, method, error) +
-          innerAdaptiveIntegration(f, meio, b, method, error);
+    // the current partition, unless the caller asked us to stop refining
+    if (fabs(i1 - i2) > error and not cancelRequested()) {
+      return innerAdaptiveIntegration(f, a, meio, method, error, depth + 1) +
+          innerAdaptiveIntegration(f, meio, b, method, error, depth + 1);
+    }
+
+    if (monitor != nullptr) {
+      adaptiveSum += i2;
+      adaptiveError += fabs(i1 - i2);
+      monitor->checkpoint(iterations, adaptiveSum, adaptiveError);
     }
 
     // otherwise, return the most precise value of the two already calculated
@@ -83,25 +285,32 @@ class Optimizer {
  public:
   using clock = chrono::high_resolution_clock;
 
-  Optimizer() {
+  BasicOptimizer() {
     executionTime = 0;
     auto seed = clock::now().time_since_epoch().count();
     myMersenne = mt19937_64(seed);
-    myUniformDistribution = uniform_real_distribution<double>(0, 1);
   }
 
-  void endClock(chrono::time_point <chrono::system_clock> start) {
-    chrono::time_point <chrono::system_clock> end = clock::now();
-    chrono::duration<float> execution_time = end - start;
+  void endClock(clock::time_point start) {
+    clock::time_point end = clock::now();
+    chrono::duration<double> execution_time = end - start;
 
     this->executionTime = execution_time.count();
   }
 
-  //! \return number of iterations until convergence
-  int getIterations() const { return iterations; }
+  //! Enables the recording of the iterations of the synchronous methods, which
+  //! is cheaper and less intrusive than the verbose flag. Asynchronous methods aren't traced
+  //! \param trace a recorder which outlives the optimizations, or null to disable tracing. It must
+  //! not be shared with optimizers running in other threads at the same time
+  void setTrace(Trace *trace) { this->trace = trace; }
+
+  Trace *getTrace() const { return trace; }
+
+  //! \return number of iterations until convergence, or of samples of the Monte Carlo methods
+  long int getIterations() const { return iterations; }
 
   //! \return error of approximation
-  double getError() const { return error; }
+  A getError() const { return error; }
 
   //! \return reason for ending the process
   const string &getEndReason() const { return endReason; }
@@ -114,29 +323,38 @@ class Optimizer {
   //! \param learnRate the learning rate of the search
   //! \param verbose whether to print a short summary of the search at every iteration
   //! \return the point at which the function intercepts the x-axis
-  double findRoot(const function<double(double)> &f, double x,
-                  double error = 1e-8, int max_iters = 1000,
-                  double learnRate = 1, bool verbose = false) throw(runtime_error) {
+  T findRoot(const function<T(T)> &f, T x,
+             T error = Utils::sqrtMachineEpsilon, int max_iters = 1000,
+             T learnRate = 1, bool verbose = false) throw(runtime_error) {
     endReason = "You didn't run any optimization yet!";
     iterations = 0;
-    double f_val;
+    T f_val;
 
     auto start = clock::now();
     while (true) {
       f_val = f(x);
-      double aux = x + learnRate * - f_val / FunctionUtils::derivative(f, x);
+      T d = Utils::derivative(f, x);
+      T aux = x + learnRate * - f_val / d;
       if (aux == x) {
         this->endReason = "No change in x from previous iteration";
         break;
       }
 
       iterations ++;
+      if (trace != nullptr and trace->sample())
+        trace->record({Trace::ROOT_FINDING, 0, iterations, x, Trace::missing(), f_val, d, Trace::missing(),
+                       aux - x});
       x = aux;
       if (verbose) {
         cout << "Iteration " << iterations << ": x = " << x
              << ", f(x) = " << f_val << '\n';
       }
 
+      if (monitor != nullptr and monitor->checkpoint(iterations, x, fabs(f_val)) and monitor->isCancelled()) {
+        this->endReason = "Cancelled before convergence";
+        break;
+      }
+
       if (iterations >= max_iters) {
         string message = "Maximum number of iterations reached";
         this->endReason = message;
@@ -160,23 +378,27 @@ class Optimizer {
   //! \param learnRate the learning rate of the search
   //! \param verbose whether to print a short summary of the search at every iteration
   //! \return the point at which the function is minimal
-  double minimize(const function<double(double)> &f,
-                  double x,
-                  double error = 1e-8, int max_iters = 1000,
-                  double learnRate = 1, bool verbose = false) throw(runtime_error) {
+  T minimize(const function<T(T)> &f,
+             T x,
+             T error = Utils::sqrtMachineEpsilon, int max_iters = 1000,
+             T learnRate = 1, bool verbose = false) throw(runtime_error) {
     endReason = "You didn't run any optimization yet!";
     iterations = 0;
-    double d;
+    T d;
 
     auto start = clock::now();
     while (true) {
-      d = FunctionUtils::derivative(f, x);
-      double aux = x - learnRate * d;
+      d = Utils::derivative(f, x);
+      T aux = x - learnRate * d;
       if (aux == x) {
         this->endReason = "No change in x from previous iteration";
         break;
       }
       iterations ++;
+      if (trace != nullptr and trace->sample())
+        // the function itself isn't evaluated by the search, so its value isn't recorded
+        trace->record({Trace::MINIMIZATION, 0, iterations, x, Trace::missing(), Trace::missing(), d,
+                       Trace::missing(), aux - x});
       x = aux;
 
       if (verbose) {
@@ -184,6 +406,11 @@ class Optimizer {
              << '\n';
       }
 
+      if (monitor != nullptr and monitor->checkpoint(iterations, x, fabs(d)) and monitor->isCancelled()) {
+        this->endReason = "Cancelled before convergence";
+        break;
+      }
+
       if (iterations >= max_iters) {
         string message = "Maximum number of iterations reached";
         this->endReason = message;
@@ -211,21 +438,21 @@ class Optimizer {
   //! iteration
   //! \return a tuple containing the {x, y} points at which the function is
   //! minimal
-  tuple<double, double>
-  minimize(const function<double(double, double)> &f, double x, double y,
-           double error = 1e-8, int max_iters = 1000, double learnRate = 1,
+  tuple<T, T>
+  minimize(const function<T(T, T)> &f, T x, T y,
+           T error = Utils::sqrtMachineEpsilon, int max_iters = 1000, T learnRate = 1,
            bool verbose = false) throw(runtime_error) {
     endReason = "You didn't run any optimization yet!";
     iterations = 0;
-    double dfdx, dfdy;
+    T dfdx, dfdy;
 
     auto start = clock::now();
     while (true) {
-      dfdx = FunctionUtils::partialDerivative(f, x, y, 0);
-      dfdy = FunctionUtils::partialDerivative(f, x, y, 1);
+      dfdx = Utils::partialDerivative(f, x, y, 0);
+      dfdy = Utils::partialDerivative(f, x, y, 1);
 
-      double aux = x - learnRate * dfdx;
-      double auy = y - learnRate * dfdy;
+      T aux = x - learnRate * dfdx;
+      T auy = y - learnRate * dfdy;
 
       if (aux == x and y == auy) {
         this->endReason = "No change in x and y from previous iteration";
@@ -233,13 +460,26 @@ class Optimizer {
       }
 
       iterations ++;
+      if (trace != nullptr and trace->sample())
+        trace->record({Trace::MINIMIZATION_2D, 0, iterations, x, y, Trace::missing(), dfdx, dfdy,
+                       sqrt((aux - x) * (aux - x) + (auy - y) * (auy - y))});
 
       x = aux;
       y = auy;
 
       if (verbose and iterations % 1000000 == 0) {
         cout << "x = " << x << ", y = " << y << ", f'(x, y) = (" << dfdx << ", "
-             << dfdy << ")\tIteration " << iterations << endl;
+             << dfdy << ")\tIteration " << iterations << '\n';
+      }
+
+      // the progress estimate of a two-dimensional search is the current value of the function,
+      // which the search doesn't compute, so it is only evaluated at chunk boundaries
+      if (monitor != nullptr and monitor->due(iterations)) {
+        monitor->report(iterations, f(x, y), fabs(dfdx) + fabs(dfdy));
+        if (monitor->isCancelled()) {
+          this->endReason = "Cancelled before convergence";
+          break;
+        }
       }
 
       if (iterations >= max_iters) {
@@ -265,39 +505,40 @@ class Optimizer {
   //! \param points the number of quadrature points to use in the approximation
   //! \param method the Newton-Cotes function to use in the approximation
   //! \return Numerical approximation of the integral of f
-  double integrate(const function<double(double)> &f, double low,
-                   double high, long int points = 40,
-                   IntegrationMethod method = SIMPSON) throw(runtime_error) {
+  A integrate(const function<T(T)> &f, T low,
+              T high, long int points = 40,
+              IntegrationMethod method = SIMPSON) throw(runtime_error) {
 
     if (low == high) {
       throw runtime_error("Lower bound of integration = Higher bound");
     }
     if (low > high) {
-      double temp = low;
+      T temp = low;
       low = high;
       high = temp;
     }
 
-    function<double(function<double(double)>, double, double)> approx;
+    function<T(function<T(T)>, T, T)> approx;
 
     if (method == SIMPSON)
-      approx = FunctionUtils::simpsonRule;
+      approx = Utils::simpsonRule;
     else if (method == RECTANGLE)
-      approx = FunctionUtils::rectangleRule;
+      approx = Utils::rectangleRule;
     else if (method == TRAPEZOID)
-      approx = FunctionUtils::trapezoidRule;
+      approx = Utils::trapezoidRule;
     else
       throw runtime_error("Unsupported integration method");
 
     auto start = clock::now();
 
-    double sum = 0;
-    double step = (high - low) / points;
+    A sum = 0;
+    T step = (high - low) / points;
 
-    if (step < 1e-8)
+    // below the machine epsilon relative to the bounds, the quadrature points can no longer be told apart
+    if (step <= Utils::machineEpsilon * max(fabs(low), fabs(high)))
       throw runtime_error("Step size of " + to_string(step) + " is too small to be precise");
 
-#pragma omp parallel for reduction(+:sum)
+#pragma omp parallel for reduction(+:sum) num_threads(parallelThreads())
     for (int i = 0; i < points; i ++)
       sum += approx(f, low + (i * step), low + ((i + 1) * step));
 
@@ -312,98 +553,491 @@ class Optimizer {
   //! \param method the Newton-Cotes function to use in the approximation
   //! \param error
   //! \return Numerical approximation of the integral of f
-  double adaptiveIntegration(const function<double(double)> &f, double a,
-                             double b, IntegrationMethod method,
-                             double error = 1e-12) {
+  A adaptiveIntegration(const function<T(T)> &f, T a,
+                        T b, IntegrationMethod method,
+                        A error = Utils::quadratureTolerance) {
     iterations = 0;
-    return innerAdaptiveIntegration(f, a, b, method, error);
+    adaptiveSum = adaptiveError = 0;
+
+    auto start = clock::now();
+    A result = innerAdaptiveIntegration(f, a, b, method, error);
+    endClock(start);
+
+    endReason = cancelRequested() ? "Cancelled before convergence" : "Minimum error threshold reached";
+    return result;
   }
 
-  double monteCarloIntegration(const function<double(double)> &f, double low,
-                               double high, long int points = 40) throw(runtime_error) {
+  //! Tanh-sinh (double exponential) quadrature, suited to integrands with
+  //! singularities at the bounds of the interval. The step between nodes is
+  //! halved at every level, reusing the values of the previous levels, until
+  //! two consecutive estimates differ by less than the tolerance
+  //! \param f function to integrate
+  //! \param a the lower bound of the integration interval, which may be -infinity
+  //! \param b the upper bound of the integration interval, which may be infinity
+  //! \param error minimum tolerance for the refinement to end
+  //! \param maxLevel maximum number of times the step is halved
+  //! \return Numerical approximation of the integral of f
+  A tanhSinhIntegration(const function<T(T)> &f, T a, T b,
+                        A error = Utils::quadratureTolerance, int maxLevel = 10) throw(runtime_error) {
+    if (a == b) {
+      throw runtime_error("Lower bound of integration = Higher bound");
+    }
+    A sign = 1;
+    if (a > b) {
+      T temp = a;
+      a = b;
+      b = temp;
+      sign = - 1;
+    }
+
+    auto start = clock::now();
 
+    // beyond tMax, the weights of the nodes fall below the square of the machine epsilon
+    T tMax = asinh(log(4 / (Utils::machineEpsilon * Utils::machineEpsilon)) / acos(T(- 1)));
+    A sum = 0, estimate = 0, previous = 0;
+    iterations = 0;
+    endReason = "Maximum level reached";
+
+    for (int level = 0; level <= maxLevel; level ++) {
+      T h = ldexp(T(1), - level);
+      long int nodes = (long int) (tMax / h);
+      // the first level uses every node, the next ones only add the odd nodes
+      long int stride = level == 0 ? 1 : 2;
+      A levelSum = level == 0 ? tanhSinhNodes(f, a, b, 0) : 0;
+
+#pragma omp parallel for reduction(+:levelSum) num_threads(parallelThreads())
+      for (long int k = 1; k <= nodes; k += stride)
+        levelSum += tanhSinhNodes(f, a, b, k * h);
+
+      iterations += 2 * ((nodes + stride - 1) / stride) + (level == 0 ? 1 : 0);
+      sum += levelSum;
+      estimate = h * sum;
+      this->error = fabs(estimate - previous);
+
+      if (trace != nullptr and trace->sample())
+        trace->record({Trace::TANH_SINH, level, iterations, Trace::missing(), Trace::missing(), estimate,
+                       Trace::missing(), Trace::missing(), this->error});
+
+      if (level > 0 and this->error <= error) {
+        endReason = "Minimum error threshold reached";
+        break;
+      }
+      previous = estimate;
+    }
+
+    endClock(start);
+    return sign * estimate;
+  }
+
+  //! Monte Carlo integration of a single-variable function. The estimate is the
+  //! mean of the sampled values times the width of the interval
+  //! \param f the function to integrate
+  //! \param low the lower bound of the integration interval
+  //! \param high the upper bound of the integration interval
+  //! \param points the number of random samples
+  //! \return Numerical approximation of the integral of f
+  A monteCarloIntegration(const function<T(T)> &f, T low,
+                          T high, long int points = 40) throw(runtime_error) {
+    return monteCarloIntegrationShard(f, low, high, points, myMersenne()).getIntegral();
+  }
+
+  //! Monte Carlo integration of a single-variable function, computing only
+  //! one shard of the samples. Shards computed with the same seed and number
+  //! of points can be merged into the result of a single run
+  //! \param f the function to integrate
+  //! \param low the lower bound of the integration interval
+  //! \param high the upper bound of the integration interval
+  //! \param points the total number of random samples of all shards
+  //! \param seed the seed of the random streams, which must be the same for all shards
+  //! \param shardIndex the index of this shard, between 0 and shardCount - 1
+  //! \param shardCount the number of shards the samples are split into
+  //! \return the sums of the samples of this shard
+  BasicMonteCarloPartial<A> monteCarloIntegrationShard(const function<T(T)> &f, T low, T high,
+                                                       long int points, uint64_t seed,
+                                                       long int shardIndex = 0,
+                                                       long int shardCount = 1) throw(runtime_error) {
     if (low == high) {
       throw runtime_error("Lower bound of integration = Higher bound");
     }
     if (low > high) {
-      double temp = low;
+      T temp = low;
       low = high;
       high = temp;
     }
 
-    double sum = 0;
+    BasicMonteCarloPartial<A> partial(BasicMonteCarloPartial<A>::INTEGRATION, seed, samplesPerBlock, points,
+                                      {low, high});
+    Range blocks = shardBlocks(points, shardIndex, shardCount);
 
     auto start = clock::now();
 
-#pragma omp parallel for reduction(+:sum)
-    for (int i = 0; i < points; i ++) {
-      double sample = f(myRandom(low, high));
-      sum += sample;
+    long int chunk = blocksPerChunk(points);
+    for (long int first = blocks.first; first < blocks.second; first += chunk) {
+      long int last = min(blocks.second, first + chunk);
+      A sum = 0, squaredSum = 0;
+      long int sampled = 0;
+
+#pragma omp parallel for reduction(+:sum) reduction(+:squaredSum) reduction(+:sampled) \
+    num_threads(parallelThreads())
+      for (long int block = first; block < last; block ++) {
+        mt19937_64 generator = blockGenerator(seed, block);
+        uniform_real_distribution<T> distribution(low, high);
+        long int size = blockSize(points, block);
+
+        for (long int i = 0; i < size; i ++) {
+          T sample = f(distribution(generator));
+          sum += sample;
+          squaredSum += (A) sample * sample;
+        }
+        sampled += size;
+      }
+
+      partial.add(make_pair(first, last), sampled, 0, sum, squaredSum, 0, 0, 0);
+      error = partial.getIntegralError();
+
+      if (trace != nullptr and trace->sample())
+        trace->record({Trace::MONTE_CARLO_INTEGRATION, 0, (long int) partial.getCount(), Trace::missing(),
+                       Trace::missing(), partial.getIntegral(), Trace::missing(), Trace::missing(), error});
+
+      if (monitor != nullptr) {
+        monitor->report(partial.getCount(), partial.getIntegral(), error);
+        if (monitor->isCancelled()) {
+          endReason = "Cancelled before all points were sampled";
+          break;
+        }
+      }
     }
 
     endClock(start);
-    iterations = points;
-    return sum / points;
-  }
-
-  VolumousObject monteCarloVolume(double xLow,
-                                  double xHigh,
-                                  double yLow,
-                                  double yHigh,
-                                  double zLow,
-                                  double zHigh,
-                                  const function<bool(double, double, double)> &isInside,
-                                  long int points) {
-    VolumousObject obj;
-    // number of pts inside the object
-    int pointsInside = 0;
-    // sum of the x, y and z coordinates of the pts inside the object
-    // useful for center of mass later
-    double xSum = 0, ySum = 0, zSum = 0;
+    iterations = partial.getCount();
+    return partial;
+  }
+
+  //! Monte Carlo estimation of the volume and center of mass of a tridimensional region
+  //! \param xLow the lower bound of the enclosing cube in the x axis
+  //! \param xHigh the upper bound of the enclosing cube in the x axis
+  //! \param yLow the lower bound of the enclosing cube in the y axis
+  //! \param yHigh the upper bound of the enclosing cube in the y axis
+  //! \param zLow the lower bound of the enclosing cube in the z axis
+  //! \param zHigh the upper bound of the enclosing cube in the z axis
+  //! \param isInside function that tells whether a point is inside the region
+  //! \param points the number of random samples
+  //! \return the estimated properties of the region
+  BasicVolumousObject<A> monteCarloVolume(T xLow,
+                                          T xHigh,
+                                          T yLow,
+                                          T yHigh,
+                                          T zLow,
+                                          T zHigh,
+                                          const function<bool(T, T, T)> &isInside,
+                                          long int points) {
+    return monteCarloVolumeShard(xLow, xHigh, yLow, yHigh, zLow, zHigh, isInside, points, myMersenne())
+        .toVolumousObject();
+  }
+
+  //! Monte Carlo estimation of the volume and center of mass of a tridimensional
+  //! region, computing only one shard of the samples. Shards computed with the same
+  //! seed and number of points can be merged into the result of a single run
+  //! \param points the total number of random samples of all shards
+  //! \param seed the seed of the random streams, which must be the same for all shards
+  //! \param shardIndex the index of this shard, between 0 and shardCount - 1
+  //! \param shardCount the number of shards the samples are split into
+  //! \return the sums of the samples of this shard
+  BasicMonteCarloPartial<A> monteCarloVolumeShard(T xLow, T xHigh, T yLow, T yHigh, T zLow, T zHigh,
+                                                  const function<bool(T, T, T)> &isInside,
+                                                  long int points, uint64_t seed,
+                                                  long int shardIndex = 0, long int shardCount = 1) {
+    BasicMonteCarloPartial<A> partial(BasicMonteCarloPartial<A>::VOLUME, seed, samplesPerBlock, points,
+                                      {xLow, xHigh, yLow, yHigh, zLow, zHigh});
+    Range blocks = shardBlocks(points, shardIndex, shardCount);
 
     auto start = clock::now();
 
-#pragma omp parallel for reduction(+:xSum) reduction(+:ySum) reduction(+:zSum) reduction(+:pointsInside)
-    for (long int i = 0; i < points; i ++) {
-      double x = myRandom(xLow, xHigh);
-      double y = myRandom(yLow, yHigh);
-      double z = myRandom(zLow, zHigh);
-
-      if (isInside(x, y, z)) {
-        pointsInside ++;
-        xSum += x;
-        ySum += y;
-        zSum += z;
+    long int chunk = blocksPerChunk(points);
+    for (long int first = blocks.first; first < blocks.second; first += chunk) {
+      long int last = min(blocks.second, first + chunk);
+      // number of pts inside the object
+      long int pointsInside = 0, sampled = 0;
+      // sum of the x, y and z coordinates of the pts inside the object
+      // useful for center of mass later
+      A xSum = 0, ySum = 0, zSum = 0;
+
+#pragma omp parallel for reduction(+:xSum) reduction(+:ySum) reduction(+:zSum) reduction(+:pointsInside) \
+    reduction(+:sampled) num_threads(parallelThreads())
+      for (long int block = first; block < last; block ++) {
+        mt19937_64 generator = blockGenerator(seed, block);
+        uniform_real_distribution<T> xDistribution(xLow, xHigh), yDistribution(yLow, yHigh),
+            zDistribution(zLow, zHigh);
+        long int size = blockSize(points, block);
+
+        for (long int i = 0; i < size; i ++) {
+          T x = xDistribution(generator);
+          T y = yDistribution(generator);
+          T z = zDistribution(generator);
+
+          if (isInside(x, y, z)) {
+            pointsInside ++;
+            xSum += x;
+            ySum += y;
+            zSum += z;
+          }
+        }
+        sampled += size;
+      }
+
+      partial.add(make_pair(first, last), sampled, pointsInside, 0, 0, xSum, ySum, zSum);
+      error = partial.getVolumeError();
+
+      if (trace != nullptr and trace->sample())
+        trace->record({Trace::MONTE_CARLO_VOLUME, 0, (long int) partial.getCount(), Trace::missing(),
+                       Trace::missing(), partial.getVolume(), Trace::missing(), Trace::missing(), error});
+
+      if (monitor != nullptr) {
+        monitor->report(partial.getCount(), partial.getVolume(), error);
+        if (monitor->isCancelled()) {
+          endReason = "Cancelled before all points were sampled";
+          break;
+        }
       }
     }
 
-    double pctInside = pointsInside / (double) points;
+    endClock(start);
+    iterations = partial.getCount();
+    return partial;
+  }
 
-    // volume of the enclosing cube
-    double cubeVolume = (xHigh - xLow) * (yHigh - yLow) * (zHigh - zLow);
-    // estimated volume of our object
-    obj.setVolume(cubeVolume * pctInside);
+  //! Monte Carlo estimation of the volume and center of mass of a tridimensional
+  //! region, which subdivides the enclosing cube into an octree. Cells fully
+  //! inside the region are counted exactly, cells fully outside are discarded and
+  //! the random samples are only spent on the cells that cross the boundary.
+  //! The octree stops short of maxDepth when the budget of points can't pay for
+  //! probing the next level and for at least 2 samples in each of its cells
+  //! \param xLow the lower bound of the enclosing cube in the x axis
+  //! \param xHigh the upper bound of the enclosing cube in the x axis
+  //! \param yLow the lower bound of the enclosing cube in the y axis
+  //! \param yHigh the upper bound of the enclosing cube in the y axis
+  //! \param zLow the lower bound of the enclosing cube in the z axis
+  //! \param zHigh the upper bound of the enclosing cube in the z axis
+  //! \param isInside function that tells whether a point is inside the region
+  //! \param points the number of evaluations of isInside, spent on probing the cells
+  //! and on random samples spread among the boundary cells
+  //! \param maxDepth the depth of the octree, whose boundary cells are 8^maxDepth times smaller than the cube
+  //! \param cellTest conservative test to classify cells. If null, cells are classified by probing isInside
+  //! \param minDepth depth until which cells are subdivided without probing, so that small regions aren't missed
+  //! \param probesPerAxis number of probes along each axis of a cell, when there is no cell test
+  //! \return the estimated properties of the region
+  BasicVolumousObject<A> monteCarloVolumeOctree(T xLow, T xHigh, T yLow, T yHigh, T zLow, T zHigh,
+                                                const function<bool(T, T, T)> &isInside, long int points,
+                                                int maxDepth = 5, const CellTest &cellTest = nullptr,
+                                                int minDepth = 2, int probesPerAxis = 3) throw(runtime_error) {
+    if (probesPerAxis < 2)
+      throw runtime_error("At least 2 probes per axis are needed to classify cells");
+    // the variance of a cell can only be estimated from 2 samples or more
+    if (points < 2)
+      throw runtime_error("At least 2 points are needed to estimate a volume");
+
+    auto start = clock::now();
+    uint64_t seed = myMersenne();
+
+    vector<Cell> cells{{xLow, xHigh, yLow, yHigh, zLow, zHigh}}, boundary;
+    // volume of the cells fully inside the region and the sums of their volume times their center
+    A insideVolume = 0, xMoment = 0, yMoment = 0, zMoment = 0;
+    long int evaluations = 0, probes = probesPerAxis * probesPerAxis * probesPerAxis;
+    bool probe = cellTest == nullptr;
+
+    for (int depth = 0; depth <= maxDepth and not cells.empty(); depth ++) {
+      vector<CellClass> classes(cells.size(), BOUNDARY_CELL);
+      long int cellCount = cells.size(), probeCost = probe ? cellCount * probes : 0;
+      bool classify = not probe or depth >= minDepth;
+      // cells which can't be probed and still get 2 samples each are sampled at this depth, unclassified
+      bool affordable = evaluations + probeCost + 2 * cellCount <= points;
+
+      if (classify and affordable) {
+#pragma omp parallel for schedule(dynamic) num_threads(parallelThreads())
+        for (long int i = 0; i < (long int) cells.size(); i ++) {
+          const Cell &c = cells[i];
+          classes[i] = probe ? probeCell(c, isInside, probesPerAxis)
+                             : cellTest(c.xLow, c.xHigh, c.yLow, c.yHigh, c.zLow, c.zHigh);
+        }
+        evaluations += probeCost;
+      }
+
+      // the children of the boundary cells must get at least 2 samples each, even if they can't be probed
+      long int boundaryCount = count(classes.begin(), classes.end(), BOUNDARY_CELL);
+      bool leaves = depth == maxDepth or (classify and not affordable) or evaluations + 16 * boundaryCount > points;
+
+      vector<Cell> next;
+      for (size_t i = 0; i < cells.size(); i ++) {
+        const Cell &c = cells[i];
+        if (classes[i] == INSIDE_CELL) {
+          A volume = c.volume();
+          insideVolume += volume;
+          xMoment += volume * (c.xLow + c.xHigh) / 2;
+          yMoment += volume * (c.yLow + c.yHigh) / 2;
+          zMoment += volume * (c.zLow + c.zHigh) / 2;
+        } else if (classes[i] == BOUNDARY_CELL) {
+          if (leaves)
+            boundary.push_back(c);
+          else
+            splitCell(c, next);
+        }
+      }
+      cells.swap(next);
+    }
+
+    // the samples are spread evenly, since all boundary cells are at the same depth
+    long int boundaryCells = boundary.size(), sampled = 0, samplesLeft = points - evaluations;
+    A sampledVolume = 0, variance = 0;
+
+#pragma omp parallel for schedule(dynamic) num_threads(parallelThreads()) reduction(+:sampledVolume) \
+    reduction(+:variance) reduction(+:xMoment) reduction(+:yMoment) reduction(+:zMoment) reduction(+:sampled)
+    for (long int cell = 0; cell < boundaryCells; cell ++) {
+      const Cell &c = boundary[cell];
+      long int samples = samplesLeft / boundaryCells + (cell < samplesLeft % boundaryCells ? 1 : 0);
+
+      mt19937_64 generator = blockGenerator(seed, cell);
+      uniform_real_distribution<T> xDistribution(c.xLow, c.xHigh), yDistribution(c.yLow, c.yHigh),
+          zDistribution(c.zLow, c.zHigh);
+
+      long int pointsInside = 0;
+      A xSum = 0, ySum = 0, zSum = 0;
+      for (long int i = 0; i < samples; i ++) {
+        T x = xDistribution(generator);
+        T y = yDistribution(generator);
+        T z = zDistribution(generator);
+
+        if (isInside(x, y, z)) {
+          pointsInside ++;
+          xSum += x;
+          ySum += y;
+          zSum += z;
+        }
+      }
+
+      A volume = c.volume(), pctInside = pointsInside / (A) samples;
+      sampledVolume += volume * pctInside;
+      // the variances of the independent estimates of each cell add up, each one
+      // estimated without bias from the variance of its samples
+      variance += volume * volume * (pctInside - pctInside * pctInside) / (samples - 1);
+      xMoment += volume * xSum / samples;
+      yMoment += volume * ySum / samples;
+      zMoment += volume * zSum / samples;
+      sampled += samples;
+    }
+
+    BasicVolumousObject<A> obj;
+    obj.setVolume(insideVolume + sampledVolume);
     //weight due to gravity
     obj.setWeight(obj.getVolume());
-
-    // according to Numerical Recipes, a suitable error measure is +/- 1 standard deviation
-    error = cubeVolume * sqrt((pctInside - pow(pctInside, 2.0f)) / points);
+    error = sqrt(variance);
     obj.setError(error);
 
-    // center of mass in the three coordinates
-    // density = 1 everywhere, so it's a straightforward sum
-    obj.getCenterOfMass().setX(xSum / pointsInside);
-    obj.getCenterOfMass().setY(ySum / pointsInside);
-    obj.getCenterOfMass().setZ(zSum / pointsInside);
+    // center of mass of the exact cells and of the sampled cells, weighted by their volumes
+    obj.getCenterOfMass().setX(xMoment / obj.getVolume());
+    obj.getCenterOfMass().setY(yMoment / obj.getVolume());
+    obj.getCenterOfMass().setZ(zMoment / obj.getVolume());
 
     endClock(start);
-
+    iterations = sampled + evaluations;
     return obj;
   }
 
-  float getExecutionTime() const {
+  double getExecutionTime() const {
     return executionTime;
   }
+
+  //! Callback receiving the progress of an asynchronous optimization
+  typedef typename ProgressMonitor<A>::Callback ProgressCallback;
+
+  //! Asynchronous version of findRoot, run in the shared thread pool.
+  //! Cancelling it returns the current approximation of the root
+  //! \param onProgress function called every chunk iterations with the current x and |f(x)|
+  //! \param chunk number of iterations between two progress reports and cancellation checks
+  AsyncTask<T, A> findRootAsync(const function<T(T)> &f, T x,
+                                T error = Utils::sqrtMachineEpsilon, int max_iters = 1000, T learnRate = 1,
+                                const ProgressCallback &onProgress = nullptr, long int chunk = 1000) {
+    return runAsync<T>([=](BasicOptimizer &o) { return o.findRoot(f, x, error, max_iters, learnRate); },
+                       onProgress, chunk);
+  }
+
+  //! Asynchronous version of the single-variable minimize, run in the shared thread pool.
+  //! Cancelling it returns the current approximation of the minimum
+  //! \param onProgress function called every chunk iterations with the current x and |f'(x)|
+  //! \param chunk number of iterations between two progress reports and cancellation checks
+  AsyncTask<T, A> minimizeAsync(const function<T(T)> &f, T x,
+                                T error = Utils::sqrtMachineEpsilon, int max_iters = 1000, T learnRate = 1,
+                                const ProgressCallback &onProgress = nullptr, long int chunk = 1000) {
+    return runAsync<T>([=](BasicOptimizer &o) { return o.minimize(f, x, error, max_iters, learnRate); },
+                       onProgress, chunk);
+  }
+
+  //! Asynchronous version of the two-variable minimize, run in the shared thread pool.
+  //! Cancelling it returns the current approximation of the minimum
+  //! \param onProgress function called every chunk iterations with the current f(x, y) and gradient norm
+  //! \param chunk number of iterations between two progress reports and cancellation checks
+  AsyncTask<tuple<T, T>, A> minimizeAsync(const function<T(T, T)> &f, T x, T y,
+                                          T error = Utils::sqrtMachineEpsilon, int max_iters = 1000, T learnRate = 1,
+                                          const ProgressCallback &onProgress = nullptr,
+                                          long int chunk = 1000) {
+    return runAsync<tuple<T, T>>(
+        [=](BasicOptimizer &o) { return o.minimize(f, x, y, error, max_iters, learnRate); },
+        onProgress, chunk);
+  }
+
+  //! Asynchronous version of adaptiveIntegration, run in the shared thread pool.
+  //! Cancelling it stops the refinement and returns the sum of the current sub-intervals
+  //! \param onProgress function called every chunk quadratures with the integral and error
+  //! of the sub-intervals accepted so far
+  //! \param chunk number of quadratures between two progress reports
+  AsyncTask<A, A> adaptiveIntegrationAsync(const function<T(T)> &f, T a, T b,
+                                           IntegrationMethod method, A error = Utils::quadratureTolerance,
+                                           const ProgressCallback &onProgress = nullptr,
+                                           long int chunk = 1000) {
+    return runAsync<A>([=](BasicOptimizer &o) { return o.adaptiveIntegration(f, a, b, method, error); },
+                       onProgress, chunk);
+  }
+
+  //! Asynchronous version of monteCarloIntegration, run in the shared thread pool.
+  //! Cancelling it returns the estimate given by the points sampled so far
+  //! \param onProgress function called every chunk points with the current estimate and error
+  //! \param chunk number of points between two progress reports and cancellation checks
+  AsyncTask<A, A> monteCarloIntegrationAsync(const function<T(T)> &f, T low, T high,
+                                             long int points = 40,
+                                             const ProgressCallback &onProgress = nullptr,
+                                             long int chunk = 1000000) {
+    return runAsync<A>([=](BasicOptimizer &o) { return o.monteCarloIntegration(f, low, high, points); },
+                       onProgress, chunk);
+  }
+
+  //! Asynchronous version of monteCarloVolume, run in the shared thread pool.
+  //! Cancelling it returns the object estimated from the points sampled so far
+  //! \param onProgress function called every chunk points with the current volume and error
+  //! \param chunk number of points between two progress reports and cancellation checks
+  AsyncTask<BasicVolumousObject<A>, A> monteCarloVolumeAsync(T xLow, T xHigh, T yLow, T yHigh,
+                                                             T zLow, T zHigh,
+                                                             const function<bool(T, T, T)> &isInside,
+                                                             long int points,
+                                                             const ProgressCallback &onProgress = nullptr,
+                                                             long int chunk = 1000000) {
+    return runAsync<BasicVolumousObject<A>>(
+        [=](BasicOptimizer &o) {
+          return o.monteCarloVolume(xLow, xHigh, yLow, yHigh, zLow, zHigh, isInside, points);
+        },
+        onProgress, chunk);
+  }
 };
 
+template<typename T, typename A>
+const long int BasicOptimizer<T, A>::samplesPerBlock;
+
+//! Optimizer working in double precision
+typedef BasicOptimizer<double> Optimizer;
+//! Optimizer working in single precision, e.g. for Monte Carlo estimates where a low relative error is enough
+typedef BasicOptimizer<float> FloatOptimizer;
+//! Optimizer working in extended precision, e.g. for ill-conditioned root finding
+typedef BasicOptimizer<long double> LongDoubleOptimizer;
+//! Mixed-precision optimizer, which evaluates functions and generates samples in single precision,
+//! but accumulates sums in double precision
+typedef BasicOptimizer<float, double> MixedPrecisionOptimizer;
+
 #endif // NUMERICAL_ANALYSIS_OPTIMIZER_HPP
\ No newline at end of file
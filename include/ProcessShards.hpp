@@ -0,0 +1,114 @@
+/**
+ * @author Douglas De Rizzo Meneghetti (douglasrizzom@gmail.com)
+ * @brief  Runs the shards of a Monte Carlo process in child processes and merges their results
+ * @date   2017-8-28
+ */
+
+#ifndef NUMERICAL_ANALYSIS_PROCESSSHARDS_HPP
+#define NUMERICAL_ANALYSIS_PROCESSSHARDS_HPP
+
+#include "MonteCarloPartial.hpp"
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <omp.h>
+
+using namespace std;
+
+//! Local driver for sharded Monte Carlo processes, which forks one child
+//! process per shard and collects the serialized partial results through pipes
+class ProcessShards {
+ private:
+  //! Writes all bytes to a file descriptor
+  static bool writeAll(int fd, const string &bytes) {
+    size_t written = 0;
+    while (written < bytes.size()) {
+      ssize_t n = ::write(fd, bytes.data() + written, bytes.size() - written);
+      if (n <= 0)
+        return false;
+      written += n;
+    }
+    return true;
+  }
+
+  //! Reads a file descriptor until the other end is closed
+  static string readAll(int fd) {
+    string bytes;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = ::read(fd, buffer, sizeof(buffer))) > 0)
+      bytes.append(buffer, n);
+    return bytes;
+  }
+
+ public:
+  //! Runs every shard in its own child process and merges their partial results.
+  //! A forked child only has the thread that called fork, and the OpenMP thread
+  //! pool of the parent can't be used in it, so each child runs its shard in a
+  //! single thread. The speedup thus comes from the processes alone, and the shard
+  //! must not rely on other threads started by the parent (e.g. asynchronous optimizations)
+  //! \param shardCount the number of shards and child processes
+  //! \param shard function that computes the partial result of a shard, given its index and the number of shards
+  //! \return the merged partial result of all shards
+  template<typename A>
+  static BasicMonteCarloPartial<A> run(int shardCount,
+                                       const function<BasicMonteCarloPartial<A>(int, int)> &shard) throw(runtime_error) {
+    if (shardCount < 1)
+      throw runtime_error("At least one shard is needed");
+
+    vector<pid_t> children;
+    vector<int> pipes;
+
+    for (int i = 0; i < shardCount; i ++) {
+      int fds[2];
+      if (pipe(fds) != 0)
+        throw runtime_error("Could not create a pipe for shard " + to_string(i));
+
+      pid_t pid = fork();
+      if (pid < 0)
+        throw runtime_error("Could not fork a process for shard " + to_string(i));
+
+      if (pid == 0) {
+        close(fds[0]);
+        // parallel regions with more than one thread would wait forever for the threads of the parent
+        omp_set_num_threads(1);
+        bool ok;
+        try {
+          ok = writeAll(fds[1], shard(i, shardCount).serialize());
+        } catch (...) {
+          ok = false;
+        }
+        close(fds[1]);
+        _exit(ok ? 0 : 1);
+      }
+
+      close(fds[1]);
+      children.push_back(pid);
+      pipes.push_back(fds[0]);
+    }
+
+    vector<string> results;
+    bool failed = false;
+    for (int i = 0; i < shardCount; i ++) {
+      results.push_back(readAll(pipes[i]));
+      close(pipes[i]);
+
+      int status;
+      waitpid(children[i], &status, 0);
+      failed = failed or not WIFEXITED(status) or WEXITSTATUS(status) != 0;
+    }
+    if (failed)
+      throw runtime_error("A shard process failed");
+
+    BasicMonteCarloPartial<A> merged = BasicMonteCarloPartial<A>::deserialize(results[0]);
+    for (int i = 1; i < shardCount; i ++)
+      merged.merge(BasicMonteCarloPartial<A>::deserialize(results[i]));
+    return merged;
+  }
+};
+
+#endif //NUMERICAL_ANALYSIS_PROCESSSHARDS_HPP
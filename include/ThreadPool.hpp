@@ -0,0 +1,97 @@
+/**
+ * @author Douglas De Rizzo Meneghetti (douglasrizzom@gmail.com)
+ * @brief  Shared pool of worker threads used by the asynchronous optimizer methods
+ * @date   2017-8-25
+ */
+
+#ifndef NUMERICAL_ANALYSIS_THREADPOOL_HPP
+#define NUMERICAL_ANALYSIS_THREADPOOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+//! Fixed-size pool of worker threads, shared by every asynchronous task of the process
+class ThreadPool {
+ private:
+  vector<thread> workers;
+  queue<function<void()>> jobs;
+  mutex jobsMutex;
+  condition_variable jobsAvailable;
+  bool stopping = false;
+  atomic<int> activeJobs{0};
+  int cores;
+
+  //! Main loop of each worker, which runs jobs until the pool is destroyed
+  void work() {
+    while (true) {
+      function<void()> job;
+      {
+        unique_lock<mutex> lock(jobsMutex);
+        jobsAvailable.wait(lock, [this] { return stopping or not jobs.empty(); });
+        if (stopping and jobs.empty())
+          return;
+        job = move(jobs.front());
+        jobs.pop();
+      }
+      activeJobs ++;
+      job();
+      activeJobs --;
+    }
+  }
+
+  explicit ThreadPool(int size) {
+    cores = max(1, (int) thread::hardware_concurrency());
+    for (int i = 0; i < size; i ++)
+      workers.emplace_back(&ThreadPool::work, this);
+  }
+
+ public:
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  ~ThreadPool() {
+    {
+      lock_guard<mutex> lock(jobsMutex);
+      stopping = true;
+    }
+    jobsAvailable.notify_all();
+    for (thread &worker : workers)
+      worker.join();
+  }
+
+  //! \return the pool shared by the whole process, with one worker per core
+  static ThreadPool &instance() {
+    static ThreadPool pool(max(1, (int) thread::hardware_concurrency()));
+    return pool;
+  }
+
+  //! Queues a job to be run by the first available worker
+  //! \param job the job to run
+  void submit(function<void()> job) {
+    {
+      lock_guard<mutex> lock(jobsMutex);
+      jobs.push(move(job));
+    }
+    jobsAvailable.notify_one();
+  }
+
+  //! Splits the cores evenly among the jobs currently running, so that the
+  //! parallel regions started by concurrent jobs don't oversubscribe the machine
+  //! \return number of threads a running job should use in its parallel regions
+  int threadsPerJob() const {
+    return max(1, cores / max(1, activeJobs.load()));
+  }
+
+  //! \return number of worker threads in the pool
+  int size() const { return (int) workers.size(); }
+};
+
+#endif //NUMERICAL_ANALYSIS_THREADPOOL_HPP
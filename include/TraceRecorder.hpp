@@ -0,0 +1,229 @@
+/**
+ * @author Douglas De Rizzo Meneghetti (douglasrizzom@gmail.com)
+ * @brief  Low-overhead recorder of the iterations of the optimizer, for later analysis
+ * @date   2017-9-12
+ */
+
+#ifndef NUMERICAL_ANALYSIS_TRACERECORDER_HPP
+#define NUMERICAL_ANALYSIS_TRACERECORDER_HPP
+
+#include <cstdint>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+using namespace std;
+
+//! Records the iterations of the optimizer in preallocated ring buffers, one
+//! per OpenMP thread, so that recording neither allocates memory nor does I/O.
+//! Only one in every decimation events is recorded, and only the most recent
+//! records are kept once a buffer is full. The records are written to a CSV or
+//! binary file after the optimization ends.
+//!
+//! Buffers are chosen by OpenMP thread number, which is 0 on any thread that
+//! isn't part of an OpenMP team. A recorder thus belongs to a single thread and
+//! its parallel regions, and must not be shared by optimizations running
+//! concurrently in different threads (e.g. in a thread pool).
+//!
+//! Columns the optimizer doesn't compute are left empty in the CSV file and are
+//! NaN in the binary file and in the records, since recording never evaluates
+//! the function again.
+//!
+//! The meaning of the columns depends on the source of the record:
+//!
+//! | source                  | iteration  | depth | x, y              | value            | gradient, gradientY | delta       |
+//! |-------------------------|------------|-------|-------------------|------------------|---------------------|-------------|
+//! | ROOT_FINDING            | iteration  | 0     | x                 | f(x)             | f'(x)               | step        |
+//! | MINIMIZATION            | iteration  | 0     | x                 |                  | f'(x)               | step        |
+//! | MINIMIZATION_2D         | iteration  | 0     | x, y              |                  | partial derivatives | step length |
+//! | ADAPTIVE_QUADRATURE     | quadrature | depth | interval [x, y]   | integral         |                     | error       |
+//! | TANH_SINH               | evaluation | level |                   | integral         |                     | error       |
+//! | MONTE_CARLO_INTEGRATION | samples    | 0     |                   | running estimate |                     | error       |
+//! | MONTE_CARLO_VOLUME      | samples    | 0     |                   | running estimate |                     | error       |
+//!
+//! \tparam A the scalar type of the recorded values
+template<typename A>
+class BasicTraceRecorder {
+ public:
+  enum Source {
+    ROOT_FINDING, MINIMIZATION, MINIMIZATION_2D, ADAPTIVE_QUADRATURE, TANH_SINH,
+    MONTE_CARLO_INTEGRATION, MONTE_CARLO_VOLUME
+  };
+
+  //! A single recorded event
+  struct Record {
+    Source source;
+    int depth;
+    long int iteration;
+    A x, y, value, gradient, gradientY, delta;
+  };
+
+  //! version of the binary format written by writeBinary()
+  static const uint8_t formatVersion = 1;
+
+  //! \return the value of a column which wasn't computed
+  static A missing() { return numeric_limits<A>::quiet_NaN(); }
+
+ private:
+  //! Ring buffer of a single thread
+  struct Ring {
+    vector<Record> records;
+    size_t next;
+    uint64_t events, written;
+    // keeps the counters of different threads in different cache lines
+    char padding[64];
+  };
+
+  vector<Ring> rings;
+  size_t capacity;
+  uint64_t decimation;
+
+  Ring &ring() {
+    return rings[omp_get_thread_num() % rings.size()];
+  }
+
+  static const char *sourceName(Source source) {
+    switch (source) {
+      case ROOT_FINDING: return "root";
+      case MINIMIZATION: return "minimum";
+      case MINIMIZATION_2D: return "minimum2d";
+      case ADAPTIVE_QUADRATURE: return "adaptive";
+      case TANH_SINH: return "tanhsinh";
+      case MONTE_CARLO_INTEGRATION: return "montecarlo";
+      case MONTE_CARLO_VOLUME: return "volume";
+    }
+    return "unknown";
+  }
+
+  template<typename V>
+  static void write(ostream &out, V value) {
+    out.write(reinterpret_cast<const char *>(&value), sizeof(V));
+  }
+
+  //! Writes a column of a CSV line, leaving it empty if it wasn't computed
+  static void writeColumn(ostream &out, A value) {
+    out << ',';
+    if (not isnan(value))
+      out << value;
+  }
+
+ public:
+  //! \param capacity maximum number of records kept by each thread
+  //! \param decimation record only one in every decimation events
+  //! \param threads number of threads which may record events
+  explicit BasicTraceRecorder(size_t capacity = 65536, uint64_t decimation = 1,
+                              int threads = omp_get_max_threads()) throw(runtime_error)
+      : capacity(capacity), decimation(decimation) {
+    if (capacity == 0 or decimation == 0 or threads < 1)
+      throw runtime_error("Trace recorder needs a positive capacity, decimation and number of threads");
+
+    rings.resize(threads);
+    for (Ring &r : rings) {
+      r.records.resize(capacity);
+      r.next = 0;
+      r.events = r.written = 0;
+    }
+  }
+
+  //! Counts an event of the calling thread
+  //! \return true if the event should be recorded, according to the decimation rate
+  bool sample() {
+    return ring().events ++ % decimation == 0;
+  }
+
+  //! Records an event in the buffer of the calling thread, overwriting the oldest record if it is full
+  void record(const Record &record) {
+    Ring &r = ring();
+    r.records[r.next] = record;
+    r.next = r.next + 1 == capacity ? 0 : r.next + 1;
+    r.written ++;
+  }
+
+  //! Erases all records
+  void clear() {
+    for (Ring &r : rings) {
+      r.next = 0;
+      r.events = r.written = 0;
+    }
+  }
+
+  //! \return number of records which were overwritten because a buffer was full
+  uint64_t getOverwritten() const {
+    uint64_t overwritten = 0;
+    for (const Ring &r : rings)
+      overwritten += r.written > capacity ? r.written - capacity : 0;
+    return overwritten;
+  }
+
+  //! \return the records kept, in the order they were recorded by each thread, one thread after the other
+  vector<Record> getRecords() const {
+    vector<Record> result;
+    for (const Ring &r : rings) {
+      size_t kept = r.written < capacity ? r.written : capacity;
+      size_t first = r.written < capacity ? 0 : r.next;
+      for (size_t i = 0; i < kept; i ++)
+        result.push_back(r.records[(first + i) % capacity]);
+    }
+    return result;
+  }
+
+  //! Writes the records as comma-separated values, with a header line
+  void writeCsv(ostream &out) const {
+    streamsize precision = out.precision(17);
+    out << "source,depth,iteration,x,y,value,gradient,gradientY,delta\n";
+    for (const Record &r : getRecords()) {
+      out << sourceName(r.source) << ',' << r.depth << ',' << r.iteration;
+      for (A value : {r.x, r.y, r.value, r.gradient, r.gradientY, r.delta})
+        writeColumn(out, value);
+      out << '\n';
+    }
+    out.precision(precision);
+  }
+
+  //! Writes the records as comma-separated values to a file
+  void writeCsv(const string &path) const throw(runtime_error) {
+    ofstream out(path);
+    if (not out)
+      throw runtime_error("Could not open " + path);
+    writeCsv(out);
+  }
+
+  //! Writes the records in a compact binary format, in the byte order of the
+  //! machine: the magic bytes "NATR", the format version, the size of the scalar
+  //! type, the number of records, and then each record as a source byte, a 32-bit
+  //! depth, a 64-bit iteration and the six scalar columns
+  void writeBinary(ostream &out) const {
+    vector<Record> records = getRecords();
+    out.write("NATR", 4);
+    write<uint8_t>(out, formatVersion);
+    write<uint8_t>(out, (uint8_t) sizeof(A));
+    write<uint64_t>(out, records.size());
+    for (const Record &r : records) {
+      write<uint8_t>(out, (uint8_t) r.source);
+      write<int32_t>(out, r.depth);
+      write<int64_t>(out, r.iteration);
+      for (A value : {r.x, r.y, r.value, r.gradient, r.gradientY, r.delta})
+        write(out, value);
+    }
+  }
+
+  //! Writes the records in the compact binary format to a file
+  void writeBinary(const string &path) const throw(runtime_error) {
+    ofstream out(path, ios::binary);
+    if (not out)
+      throw runtime_error("Could not open " + path);
+    writeBinary(out);
+  }
+};
+
+template<typename A>
+const uint8_t BasicTraceRecorder<A>::formatVersion;
+
+typedef BasicTraceRecorder<double> TraceRecorder;
+
+#endif //NUMERICAL_ANALYSIS_TRACERECORDER_HPP
@@ -7,41 +7,44 @@
 
 #include <string>
 
-class Point3D {
+//! A point in tridimensional space
+//! \tparam T the scalar type of the coordinates
+template<typename T>
+class BasicPoint3D {
  private:
-  double x, y, z;
+  T x, y, z;
  public:
-  Point3D() {
+  BasicPoint3D() {
     x = y = z = 0;
   }
 
-  Point3D(double x, double y, double z) {
+  BasicPoint3D(T x, T y, T z) {
     this->x = x;
     this->y = y;
     this->z = z;
   }
 
-  double getX() const {
+  T getX() const {
     return x;
   }
 
-  void setX(double x) {
+  void setX(T x) {
     this->x = x;
   }
 
-  double getY() const {
+  T getY() const {
     return y;
   }
 
-  void setY(double y) {
+  void setY(T y) {
     this->y = y;
   }
 
-  double getZ() const {
+  T getZ() const {
     return z;
   }
 
-  void setZ(double z) {
+  void setZ(T z) {
     this->z = z;
   }
 
@@ -50,45 +53,48 @@ class Point3D {
   }
 };
 
-class VolumousObject {
+//! Properties of a tridimensional region estimated by numerical methods
+//! \tparam T the scalar type of the estimated quantities
+template<typename T>
+class BasicVolumousObject {
  private:
-  double volume, weight, error;
-  Point3D centerOfMass;
+  T volume, weight, error;
+  BasicPoint3D<T> centerOfMass;
  public:
 
-  VolumousObject() {
+  BasicVolumousObject() {
     volume = weight = error = 0;
   }
 
-  double getVolume() const {
+  T getVolume() const {
     return volume;
   }
 
-  void setVolume(double volume) {
+  void setVolume(T volume) {
     this->volume = volume;
   }
 
-  double getWeight() const {
+  T getWeight() const {
     return weight;
   }
 
-  void setWeight(double weight) {
+  void setWeight(T weight) {
     this->weight = weight;
   }
 
-  Point3D &getCenterOfMass() {
+  BasicPoint3D<T> &getCenterOfMass() {
     return centerOfMass;
   }
 
-  void setCenterOfMass(const Point3D &centerOfMass) {
+  void setCenterOfMass(const BasicPoint3D<T> &centerOfMass) {
     this->centerOfMass = centerOfMass;
   }
 
-  void setError(double error) {
+  void setError(T error) {
     this->error = error;
   }
 
-  double getError() { return this->error; }
+  T getError() { return this->error; }
 
   std::string toString() {
     return "Object details:\n\tVolume: " + std::to_string(volume) + "\n\tWeight:" + std::to_string(weight)
@@ -96,4 +102,7 @@ class VolumousObject {
   }
 };
 
+typedef BasicPoint3D<double> Point3D;
+typedef BasicVolumousObject<double> VolumousObject;
+
 #endif //NUMERICAL_ANALYSIS_VOLUMOUSOBJECT_HPP
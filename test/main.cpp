@@ -2,6 +2,8 @@
 #include <sstream>
 #include "FunctionUtils.hpp"
 #include "Optimizer.hpp"
+#include "Chebyshev.hpp"
+#include "ProcessShards.hpp"
 
 using namespace std;
 
@@ -46,6 +48,10 @@ double fh(double x) { return 4 / (1 + x * x); }
 //! \return sqrt(x + sqrt(x))
 double fi(double x) { return sqrt(x + sqrt(x)); }
 
+//! \param x
+//! \return e^-x
+double fj(double x) { return exp(- x); }
+
 //! Function that defines a toroid in relation to its cartesian coordinates
 //! \param x
 //! \param y
@@ -55,6 +61,34 @@ bool isInMyToroid(double x, double y, double z) {
   return x > 1 and y >= - 3 and (z * z) + pow(sqrt((x * x) + (y * y)) - 3, 2) <= 1;
 }
 
+//! \param low the lower bound of an interval
+//! \param high the upper bound of an interval
+//! \return the smallest and largest absolute values in the interval
+pair<double, double> absoluteRange(double low, double high) {
+  double smallest = low <= 0 and high >= 0 ? 0 : min(fabs(low), fabs(high));
+  return {smallest, max(fabs(low), fabs(high))};
+}
+
+//! Conservative test of whether a cell is fully inside or outside the toroid,
+//! from the range of distances between the points of the cell and the center of the tube
+//! \return the class of the cell
+Optimizer::CellClass classifyMyToroidCell(double xLow, double xHigh, double yLow, double yHigh,
+                                          double zLow, double zHigh) {
+  if (xHigh <= 1 or yHigh < - 3)
+    return Optimizer::OUTSIDE_CELL;
+
+  pair<double, double> x = absoluteRange(xLow, xHigh), y = absoluteRange(yLow, yHigh),
+      z = absoluteRange(zLow, zHigh);
+  pair<double, double> radius = {sqrt(pow(x.first, 2) + pow(y.first, 2)), sqrt(pow(x.second, 2) + pow(y.second, 2))};
+  pair<double, double> tube = absoluteRange(radius.first - 3, radius.second - 3);
+
+  if (pow(tube.first, 2) + pow(z.first, 2) > 1)
+    return Optimizer::OUTSIDE_CELL;
+  if (pow(tube.second, 2) + pow(z.second, 2) <= 1 and xLow > 1 and yLow >= - 3)
+    return Optimizer::INSIDE_CELL;
+  return Optimizer::BOUNDARY_CELL;
+}
+
 void testSingleRoot(const function<double(double)> &f,
                     double x,
                     double error,
@@ -126,6 +160,19 @@ void testMinimization(double x, double y, double error,
   testDoubleVariableMinimization(fd, x, y, error, iters, learnRateFraction);
 }
 
+void testTrace(double x, double y, int iters) {
+  Optimizer o;
+  // keeps one in every 10000 iterations of the search
+  TraceRecorder trace(1024, 10000);
+  o.setTrace(&trace);
+  try {
+    o.minimize(fd, x, y, 1e-8, iters, 0.001);
+  } catch (const runtime_error &exp) {
+    cout << exp.what() << endl;
+  }
+  trace.writeCsv(cout);
+}
+
 template<typename T>
 std::string to_string_with_precision(const T a_value, const int n = 12) {
   std::ostringstream out;
@@ -172,6 +219,14 @@ void testSingleIntegral(const function<double(double)> &f, double low, double hi
   } catch (const runtime_error &x) {
     cout << x.what() << endl;
   }
+  try {
+    result = o.tanhSinhIntegration(f, low, high);
+    cout << printWithError(result, trueValue)
+         << "\ttanh-sinh (evaluations: " << o.getIterations() << ", time: " << o.getExecutionTime() << ")"
+         << endl;
+  } catch (const runtime_error &x) {
+    cout << x.what() << endl;
+  }
   try {
     for (int i = 1; i <= 8; i ++) {
       double points = pow(10, i);
@@ -184,6 +239,17 @@ void testSingleIntegral(const function<double(double)> &f, double low, double hi
   }
 }
 
+void testInfiniteIntegral(const function<double(double)> &f, double low, double high, double trueValue) {
+  Optimizer o;
+  try {
+    double result = o.tanhSinhIntegration(f, low, high);
+    cout << printWithError(result, trueValue) << "\ttanh-sinh in [" << low << ", " << high << "] (evaluations: "
+         << o.getIterations() << ", time: " << o.getExecutionTime() << ")" << endl;
+  } catch (const runtime_error &x) {
+    cout << x.what() << endl;
+  }
+}
+
 void testIntegrals(double low, double high, int quadratures) {
   double s1 = expm1(1.0), s2 = M_PI_4, s3 = sqrt(M_PI) / 2 * erf(high), s4 = M_PI, s5 = 1.04530130813919;
 
@@ -195,6 +261,58 @@ void testIntegrals(double low, double high, int quadratures) {
   testSingleIntegral(fg, low, high, quadratures, s3);
   testSingleIntegral(fh, low, high, quadratures, s4);
   testSingleIntegral(fi, low, high, quadratures, s5);
+
+  double infinity = numeric_limits<double>::infinity();
+  cout << "Integrating e^-x in [0, infinity)..." << endl;
+  testInfiniteIntegral(fj, 0, infinity, 1);
+  cout << "Integrating exp(-(x^2)) in (-infinity, infinity)..." << endl;
+  testInfiniteIntegral(fg, - infinity, infinity, sqrt(M_PI));
+  cout << "Integrating exp(-(x^2)) in (-infinity, 0]..." << endl;
+  testInfiniteIntegral(fg, - infinity, 0, sqrt(M_PI) / 2);
+}
+
+//! Integrates e^x in [0, 1] and estimates the volume of the toroid with an optimizer of the given precision
+//! \tparam T the scalar type in which functions are evaluated
+//! \tparam A the scalar type in which sums are accumulated
+template<typename T, typename A>
+void testPrecision(const string &name) {
+  typedef BasicOptimizer<T, A> PrecisionOptimizer;
+  PrecisionOptimizer o;
+  function<T(T)> f = [](T x) { return exp(x); };
+  cout << name << ":" << endl;
+
+  try {
+    A result = o.integrate(f, 0, 1, 10000);
+    cout << "\t" << printWithError(result, expm1(1.0)) << "\tsimpson rule (time: " << o.getExecutionTime() << ")"
+         << endl;
+    result = o.adaptiveIntegration(f, 0, 1, PrecisionOptimizer::SIMPSON);
+    cout << "\t" << printWithError(result, expm1(1.0))
+         << "\tadaptive simpson rule (quadratures: " << o.getIterations() << ", time: " << o.getExecutionTime() << ")"
+         << endl;
+  } catch (const runtime_error &x) {
+    cout << x.what() << endl;
+  }
+
+  BasicVolumousObject<A> toroid = o.monteCarloVolume(1, 4, - 3, 4, - 1, 1, [](T x, T y, T z) {
+    return x > 1 and y >= - 3 and (z * z) + pow(sqrt((x * x) + (y * y)) - 3, 2) <= 1;
+  }, 1000000);
+  cout << "\ttoroid volume: " << toroid.getVolume() << " +- " << toroid.getError()
+       << " (time: " << o.getExecutionTime() << ")" << endl;
+}
+
+void testChebyshevProxy(const function<double(double)> &f, double low, double high) {
+  Chebyshev proxy(f, low, high);
+  cout << "Chebyshev proxy of degree " << proxy.getDegree() << " in [" << low << ", " << high << "]" << endl;
+  cout << "\tintegral: " << to_string_with_precision(proxy.integral()) << endl;
+  cout << "\troots:";
+  for (double root : proxy.roots())
+    cout << " " << to_string_with_precision(root);
+  cout << endl;
+  cout << "\tglobal minimum: " << to_string_with_precision(proxy.minimum()) << endl;
+
+  // the proxy can be given to the optimizer in place of the original function
+  Optimizer o;
+  cout << "\tsimpson rule on the proxy: " << to_string_with_precision(o.integrate(proxy, low, high, 1000)) << endl;
 }
 
 void testToroid() {
@@ -208,6 +326,61 @@ void testToroid() {
   }
 }
 
+void testOctreeToroid() {
+  for (int i = 1; i <= 7; i ++) {
+    double points = pow(10, i);
+    Optimizer o;
+    VolumousObject plain = o.monteCarloVolume(1, 4, - 3, 4, - 1, 1, isInMyToroid, points);
+    cout << "Number of points: " << points << endl;
+    cout << "\tplain: " << plain.getVolume() << " +- " << plain.getError()
+         << " (time: " << o.getExecutionTime() << ")" << endl;
+    VolumousObject probed = o.monteCarloVolumeOctree(1, 4, - 3, 4, - 1, 1, isInMyToroid, points);
+    cout << "\toctree with probes: " << probed.getVolume() << " +- " << probed.getError()
+         << " (evaluations: " << o.getIterations() << ", time: " << o.getExecutionTime() << ")" << endl;
+    VolumousObject tested = o.monteCarloVolumeOctree(1, 4, - 3, 4, - 1, 1, isInMyToroid, points, 5,
+                                                     classifyMyToroidCell);
+    cout << "\toctree with cell test: " << tested.getVolume() << " +- " << tested.getError()
+         << " (evaluations: " << o.getIterations() << ", time: " << o.getExecutionTime() << ")" << endl;
+  }
+}
+
+void testCancelledToroid() {
+  Optimizer o;
+  // far more points than could be sampled before the cancellation
+  auto task = o.monteCarloVolumeAsync(1, 4, - 3, 4, - 1, 1, isInMyToroid, 100000000000, [](const Progress<double> &p) {
+    cout << "\t" << p.samples << " points: " << p.estimate << " +- " << p.error << endl;
+  }, 10000000);
+
+  if (not task.waitFor(chrono::seconds(1)))
+    task.cancel();
+  VolumousObject toroid = task.get();
+  cout << "Cancelled toroid: " << toroid.getVolume() << " +- " << toroid.getError() << " (points: "
+       << task.getIterations() << ", reason: " << task.getEndReason() << ")" << endl;
+}
+
+void testShardedToroid(int shards) {
+  long int points = 100000000;
+  uint64_t seed = 42;
+  Optimizer o;
+  MonteCarloPartial single = o.monteCarloVolumeShard(1, 4, - 3, 4, - 1, 1, isInMyToroid, points, seed);
+  cout << "Single process: " << to_string_with_precision(single.getVolume()) << " +- "
+       << to_string_with_precision(single.getVolumeError()) << " (time: " << o.getExecutionTime() << ")" << endl;
+
+  auto start = Optimizer::clock::now();
+  MonteCarloPartial merged = ProcessShards::run<double>(shards, [=](int shardIndex, int shardCount) {
+    Optimizer shardOptimizer;
+    return shardOptimizer.monteCarloVolumeShard(1, 4, - 3, 4, - 1, 1, isInMyToroid, points, seed,
+                                                shardIndex, shardCount);
+  });
+  chrono::duration<double> elapsed = Optimizer::clock::now() - start;
+  // the merged shards must give the same estimate and error as the single process
+  cout << shards << " processes: " << to_string_with_precision(merged.getVolume()) << " +- "
+       << to_string_with_precision(merged.getVolumeError()) << " (difference from the single process: "
+       << to_string_with_precision(fabs(merged.getVolume() - single.getVolume())) << " in the volume, "
+       << to_string_with_precision(fabs(merged.getVolumeError() - single.getVolumeError()))
+       << " in the error, time: " << elapsed.count() << ")" << endl;
+}
+
 int main() {
   cout.precision(12);
   double x = 2, y = 2, error = 1e-50, low = 0, high = 1;
@@ -218,7 +391,16 @@ int main() {
 
 //  testRoots(x, error, iters, learnRateFraction, o);
 //  testMinimization(x, y, error, iters, learnRateFraction);
+  testTrace(x, y, iters);
   testIntegrals(low, high, quadratures);
+  testPrecision<float, float>("single precision");
+  testPrecision<double, double>("double precision");
+  testPrecision<long double, long double>("extended precision");
+  testPrecision<float, double>("mixed precision");
+  testChebyshevProxy(fb, - 2, 3);
   testToroid();
+  testOctreeToroid();
+  testCancelledToroid();
+  testShardedToroid(4);
   return 0;
 }